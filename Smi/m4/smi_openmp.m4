@@ -0,0 +1,54 @@
+# Copyright (C) 2026 International Business Machines and others.
+# All Rights Reserved.
+# This file is distributed under the Common Public License.
+
+## $Id$
+
+# AC_SMI_OPENMP
+# -------------
+# Finds the option of the current language's compiler that enables
+# OpenMP and sets OPENMP_CXXFLAGS to it; empty when the compiler needs
+# none, has none, or --disable-openmp is given.  This is the check of
+# Autoconf 2.62's AC_OPENMP, for the Autoconf 2.59 of the COIN BuildTools.
+# Call it between AC_LANG_PUSH(C++) and AC_LANG_POP(C++).
+
+AC_DEFUN([AC_SMI_OPENMP],
+[
+  OPENMP_CXXFLAGS=
+  AC_ARG_ENABLE([openmp],
+    [AS_HELP_STRING([--disable-openmp], [do not use OpenMP])])
+  if test "$enable_openmp" != no; then
+    AC_CACHE_CHECK([for $CXX option to support OpenMP],
+      [ac_cv_prog_cxx_openmp],
+      [AC_LANG_CONFTEST([[
+#ifndef _OPENMP
+ choke me
+#endif
+#include <omp.h>
+int main () { return omp_get_num_threads (); }
+]])
+      ac_cv_prog_cxx_openmp='not found'
+      for ac_option in '' -fopenmp -openmp -qopenmp -xopenmp -mp -omp -qsmp=omp; do
+        ac_save_CXXFLAGS=$CXXFLAGS
+        CXXFLAGS="$CXXFLAGS $ac_option"
+        AC_LINK_IFELSE([],
+          [if test "x$ac_option" = x; then
+            ac_cv_prog_cxx_openmp='none needed'
+          else
+            ac_cv_prog_cxx_openmp=$ac_option
+          fi])
+        CXXFLAGS=$ac_save_CXXFLAGS
+        if test "$ac_cv_prog_cxx_openmp" != 'not found'; then
+          break
+        fi
+      done
+      rm -f conftest.$ac_ext])
+    case $ac_cv_prog_cxx_openmp in
+      "none needed" | "not found")
+        ;;
+      *)
+        OPENMP_CXXFLAGS=$ac_cv_prog_cxx_openmp ;;
+    esac
+  fi
+AC_SUBST(OPENMP_CXXFLAGS)
+])
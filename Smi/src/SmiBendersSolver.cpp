@@ -0,0 +1,434 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#include "SmiBendersSolver.hpp"
+#include "CoinPackedMatrix.hpp"
+#include "CoinHelperFunctions.hpp"
+#include "CoinWarmStart.hpp"
+#include <assert.h>
+#include <math.h>
+
+using namespace std;
+
+//#############################################################################
+// Work arrays for one scenario subproblem
+//#############################################################################
+
+class SmiBendersWork
+{
+public:
+    SmiBendersWork(SmiCoreData *core)
+    {
+        int ncol = core->getNumCols();
+        int nrow = core->getNumRows();
+        clo = new double[ncol];
+        cup = new double[ncol];
+        obj = new double[ncol];
+        rlo = new double[nrow];
+        rup = new double[nrow];
+        rstrt = new int[nrow+1];
+        denseRow = new double[ncol+1];
+    }
+    ~SmiBendersWork()
+    {
+        delete [] clo;
+        delete [] cup;
+        delete [] obj;
+        delete [] rlo;
+        delete [] rup;
+        delete [] rstrt;
+        delete [] denseRow;
+    }
+
+    // scenario problem in core positions (see SmiScnModel::fillScenarioArrays)
+    double *clo;
+    double *cup;
+    double *obj;
+    double *rlo;
+    double *rup;
+    int *rstrt;
+    double *denseRow;
+    vector<double> dels;
+    vector<int> indx;
+
+    // stage 1 part: W block by row, shifted row bounds, elastic columns
+    vector<double> wels;
+    vector<int> windx;
+    vector<int> wstrt;
+    vector<double> slo;
+    vector<double> sup;
+    vector<double> eclo;
+    vector<double> ecup;
+    vector<double> eobj;
+};
+
+//#############################################################################
+// Evaluates scenario subproblems on the workers of a pool
+//#############################################################################
+
+class SmiBendersEvaluate
+{
+public:
+    SmiBendersEvaluate(SmiBendersSolver *benders, vector<SmiBendersWork *> &work, vector<CoinWarmStart *> &basis,
+        const double *x, vector<double> &value, vector<int> &status, vector<double> &grad):
+        benders_(benders),work_(work),basis_(basis),x_(x),value_(value),status_(status),grad_(grad) {}
+
+    void operator() (OsiSolverInterface *sub, int worker, int is)
+    {
+        int ncol0 = benders_->ncol0_;
+        status_[is] = benders_->evaluateScenario(sub,*work_[worker],basis_[is],is,x_,value_[is],&grad_[is*ncol0]);
+    }
+
+private:
+    SmiBendersSolver *benders_;
+    vector<SmiBendersWork *> &work_;
+    vector<CoinWarmStart *> &basis_;
+    const double *x_;
+    vector<double> &value_;
+    vector<int> &status_;
+    vector<double> &grad_;
+};
+
+//#############################################################################
+
+SmiBendersSolver::SmiBendersSolver(SmiScnModel *smi, OsiSolverInterface *osi):
+    smi_(smi),core_(NULL),master_(NULL),sub_(NULL),
+    ncol0_(0),nrow0_(0),ncol1_(0),nrow1_(0),
+    multiCut_(false),maxIter_(1000),gapTol_(1.0e-6),thetaLb_(-osi->getInfinity()),numThreads_(smi->getNumThreads()),
+    lowerBound_(-osi->getInfinity()),upperBound_(osi->getInfinity()),
+    numIter_(0),numOptCuts_(0),numFeasCuts_(0)
+{
+    master_ = osi->clone(false);
+    sub_ = osi->clone(false);
+
+    // the core of the tree; getCore() is only set by readSmps
+    core_ = smi_->getRootNode()->getNode()->getCore();
+    assert(core_->getNumStages() == 2);
+    ncol0_ = core_->getNumCols(0);
+    nrow0_ = core_->getNumRows(0);
+    ncol1_ = core_->getNumCols(1);
+    nrow1_ = core_->getNumRows(1);
+}
+
+SmiBendersSolver::~SmiBendersSolver()
+{
+    delete master_;
+    delete sub_;
+}
+
+void
+SmiBendersSolver::buildMaster()
+{
+    int nscen = smi_->getNumScenarios();
+    double inf = master_->getInfinity();
+
+    // normalized probabilities, as in the det. eq.
+    prob_.resize(nscen);
+    double totalProb = 0.0;
+    for (int is=0; is<nscen; ++is)
+    {
+        prob_[is] = smi_->getLeafNode(is)->getProb();
+        totalProb += prob_[is];
+    }
+    for (int is=0; is<nscen; ++is)
+        prob_[is] /= totalProb;
+
+    // stage 0 block of any scenario is the master's
+    SmiBendersWork w(core_);
+    smi_->fillScenarioArrays(0,w.clo,w.cup,w.obj,w.rlo,w.rup,w.dels,w.indx,w.rstrt,w.denseRow);
+    int nels0 = w.rstrt[nrow0_];
+
+    // recourse variables: fixed at zero until their first cut
+    int ntheta = multiCut_ ? nscen : 1;
+    int ncol = ncol0_+ntheta;
+    vector<double> clo(w.clo,w.clo+ncol0_);
+    vector<double> cup(w.cup,w.cup+ncol0_);
+    vector<double> obj(w.obj,w.obj+ncol0_);
+    clo.resize(ncol,0.0);
+    cup.resize(ncol,0.0);
+    if (multiCut_)
+        obj.insert(obj.end(),prob_.begin(),prob_.end());
+    else
+        obj.push_back(1.0);
+    thetaFree_.assign(ntheta,false);
+
+    CoinPackedMatrix matrix(false,ncol,nrow0_,nels0,&w.dels[0],&w.indx[0],w.rstrt,NULL);
+    master_->loadProblem(matrix,&clo[0],&cup[0],&obj[0],w.rlo,w.rup);
+    master_->setObjSense(1.0);
+
+    lowerBound_ = -inf;
+    upperBound_ = inf;
+    bestX_.clear();
+    numIter_ = 0;
+    numOptCuts_ = 0;
+    numFeasCuts_ = 0;
+}
+
+int
+SmiBendersSolver::solve()
+{
+    buildMaster();
+
+    int nscen = smi_->getNumScenarios();
+    int ntheta = multiCut_ ? nscen : 1;
+    vector<double> value(nscen);
+    vector<int> status(nscen);
+    vector<double> grad(nscen*ncol0_);
+    vector<double> aggGrad(ncol0_);
+
+    // subproblem solvers and work arrays, one per worker, kept across
+    // iterations; warm starts are kept per scenario, so a subproblem does
+    // not depend on which worker solved what before it
+    SmiScenarioWorkerPool pool(sub_,numThreads_);
+    vector<SmiBendersWork *> work(pool.getNumWorkers());
+    for (unsigned int k=0; k<work.size(); ++k)
+        work[k] = new SmiBendersWork(core_);
+    vector<CoinWarmStart *> basis(nscen,(CoinWarmStart *)NULL);
+    int rc = 1;
+
+    while (numIter_ < maxIter_)
+    {
+        if (numIter_)
+            master_->resolve();
+        else
+            master_->initialSolve();
+        numIter_++;
+        if (!master_->isProvenOptimal())
+        {
+            rc = -1;
+            break;
+        }
+
+        const double *msol = master_->getColSolution();
+        vector<double> x(msol,msol+ncol0_);
+        vector<double> theta(msol+ncol0_,msol+ncol0_+ntheta);
+
+        // the master value bounds the optimum once every theta carries a cut
+        bool allFree = true;
+        for (int k=0; k<ntheta; ++k)
+            allFree = allFree && thetaFree_[k];
+        if (allFree)
+            lowerBound_ = CoinMax(lowerBound_,master_->getObjValue());
+
+        // scenario subproblems; results are indexed by scenario
+        SmiBendersEvaluate evaluate(this,work,basis,&x[0],value,status,grad);
+        pool.run(nscen,evaluate);
+        bool failed = false;
+        for (int is=0; is<nscen; ++is)
+            failed = failed || status[is] < 0;
+        if (failed)
+        {
+            rc = -1;
+            break;
+        }
+
+        // cuts
+        int ncuts = 0;
+        bool feasible = true;
+        for (int is=0; is<nscen; ++is)
+        {
+            if (status[is] == 1)
+            {
+                addFeasibilityCut(value[is],&grad[is*ncol0_],&x[0]);
+                feasible = false;
+                ncuts++;
+            }
+        }
+        if (feasible)
+        {
+            // x is feasible: upper bound
+            const double *cobj = master_->getObjCoefficients();
+            double z = 0.0;
+            for (int j=0; j<ncol0_; ++j)
+                z += cobj[j]*x[j];
+            double recourse = 0.0;
+            for (int is=0; is<nscen; ++is)
+                recourse += prob_[is]*value[is];
+            if (z+recourse < upperBound_)
+            {
+                upperBound_ = z+recourse;
+                bestX_ = x;
+            }
+
+            double tol = gapTol_*(1.0+fabs(upperBound_));
+            if (multiCut_)
+            {
+                for (int is=0; is<nscen; ++is)
+                {
+                    if (!thetaFree_[is] || theta[is] < value[is]-tol)
+                    {
+                        addOptimalityCut(is,value[is],&grad[is*ncol0_],&x[0]);
+                        ncuts++;
+                    }
+                }
+            }
+            else if (!thetaFree_[0] || theta[0] < recourse-tol)
+            {
+                CoinFillN(&aggGrad[0],ncol0_,0.0);
+                for (int is=0; is<nscen; ++is)
+                    for (int j=0; j<ncol0_; ++j)
+                        aggGrad[j] += prob_[is]*grad[is*ncol0_+j];
+                addOptimalityCut(0,recourse,&aggGrad[0],&x[0]);
+                ncuts++;
+            }
+        }
+
+        // no gap to measure before the first feasible x
+        if (!ncuts || (upperBound_ < master_->getInfinity() &&
+                upperBound_-lowerBound_ <= gapTol_*(1.0+fabs(upperBound_))))
+        {
+            lowerBound_ = CoinMin(lowerBound_,upperBound_);
+            rc = 0;
+            break;
+        }
+    }
+
+    for (unsigned int k=0; k<work.size(); ++k)
+        delete work[k];
+    for (int is=0; is<nscen; ++is)
+        delete basis[is];
+    return rc;
+}
+
+int
+SmiBendersSolver::evaluateScenario(OsiSolverInterface *sub, SmiBendersWork &w, CoinWarmStart *&basis,
+    int is, const double *x, double &value, double *grad)
+{
+    double inf = sub->getInfinity();
+    smi_->fillScenarioArrays(is,w.clo,w.cup,w.obj,w.rlo,w.rup,w.dels,w.indx,w.rstrt,w.denseRow);
+
+    // stage 1 rows: W y in the bounds shifted by T x
+    w.wels.clear();
+    w.windx.clear();
+    w.wstrt.assign(1,0);
+    w.slo.resize(nrow1_);
+    w.sup.resize(nrow1_);
+    for (int r=0; r<nrow1_; ++r)
+    {
+        int i = nrow0_+r;
+        double tx = 0.0;
+        for (int e=w.rstrt[i]; e<w.rstrt[i+1]; ++e)
+        {
+            if (w.indx[e] < ncol0_)
+                tx += w.dels[e]*x[w.indx[e]];
+            else
+            {
+                w.wels.push_back(w.dels[e]);
+                w.windx.push_back(w.indx[e]-ncol0_);
+            }
+        }
+        w.wstrt.push_back(static_cast<int>(w.wels.size()));
+        w.slo[r] = w.rlo[i] > -inf ? w.rlo[i]-tx : -inf;
+        w.sup[r] = w.rup[i] < inf ? w.rup[i]-tx : inf;
+    }
+
+    int nw = static_cast<int>(w.wels.size());
+    CoinPackedMatrix matrix(false,ncol1_,nrow1_,nw,w.wels.empty() ? NULL : &w.wels[0],
+        w.windx.empty() ? NULL : &w.windx[0],&w.wstrt[0],NULL);
+    sub->loadProblem(matrix,w.clo+ncol0_,w.cup+ncol0_,w.obj+ncol0_,&w.slo[0],&w.sup[0]);
+    sub->setObjSense(1.0);
+    if (basis)
+    {
+        // start from the last basis of the scenario
+        sub->setWarmStart(basis);
+        sub->resolve();
+    }
+    else
+    {
+        // loadProblem dropped the basis of the worker's previous subproblem
+        sub->initialSolve();
+    }
+
+    int status = 0;
+    if (sub->isProvenPrimalInfeasible())
+    {
+        // elastic form: y, s+, s- with W y + s+ - s- in the shifted bounds
+        int ncol = ncol1_+2*nrow1_;
+        matrix.setDimensions(nrow1_,ncol);
+        for (int r=0; r<nrow1_; ++r)
+        {
+            matrix.modifyCoefficient(r,ncol1_+r,1.0);
+            matrix.modifyCoefficient(r,ncol1_+nrow1_+r,-1.0);
+        }
+        w.eclo.assign(w.clo+ncol0_,w.clo+ncol0_+ncol1_);
+        w.ecup.assign(w.cup+ncol0_,w.cup+ncol0_+ncol1_);
+        w.eobj.assign(ncol1_,0.0);
+        w.eclo.resize(ncol,0.0);
+        w.ecup.resize(ncol,inf);
+        w.eobj.resize(ncol,1.0);
+        sub->loadProblem(matrix,&w.eclo[0],&w.ecup[0],&w.eobj[0],&w.slo[0],&w.sup[0]);
+        sub->initialSolve();
+        status = 1;
+    }
+    if (!sub->isProvenOptimal())
+        return -1;
+    if (!status)
+    {
+        delete basis;
+        basis = sub->getWarmStart();
+    }
+
+    // subgradient of the value in x: the row bounds move by -T x
+    value = sub->getObjValue();
+    const double *pi = sub->getRowPrice();
+    CoinFillN(grad,ncol0_,0.0);
+    for (int r=0; r<nrow1_; ++r)
+    {
+        int i = nrow0_+r;
+        if (!pi[r])
+            continue;
+        for (int e=w.rstrt[i]; e<w.rstrt[i+1]; ++e)
+        {
+            if (w.indx[e] < ncol0_)
+                grad[w.indx[e]] -= pi[r]*w.dels[e];
+        }
+    }
+    return status;
+}
+
+void
+SmiBendersSolver::addOptimalityCut(int theta, double value, const double *grad, const double *x)
+{
+    double inf = master_->getInfinity();
+    vector<int> ind;
+    vector<double> els;
+    double rhs = value;
+    for (int j=0; j<ncol0_; ++j)
+    {
+        if (grad[j])
+        {
+            ind.push_back(j);
+            els.push_back(-grad[j]);
+            rhs -= grad[j]*x[j];
+        }
+    }
+    ind.push_back(ncol0_+theta);
+    els.push_back(1.0);
+    master_->addRow(static_cast<int>(ind.size()),&ind[0],&els[0],rhs,inf);
+    if (!thetaFree_[theta])
+    {
+        master_->setColBounds(ncol0_+theta,thetaLb_,inf);
+        thetaFree_[theta] = true;
+    }
+    numOptCuts_++;
+}
+
+void
+SmiBendersSolver::addFeasibilityCut(double value, const double *grad, const double *x)
+{
+    double inf = master_->getInfinity();
+    vector<int> ind;
+    vector<double> els;
+    double rhs = -value;
+    for (int j=0; j<ncol0_; ++j)
+    {
+        if (grad[j])
+        {
+            ind.push_back(j);
+            els.push_back(grad[j]);
+            rhs += grad[j]*x[j];
+        }
+    }
+    master_->addRow(static_cast<int>(ind.size()),ind.empty() ? NULL : &ind[0],els.empty() ? NULL : &els[0],-inf,rhs);
+    numFeasCuts_++;
+}
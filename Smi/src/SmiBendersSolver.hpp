@@ -0,0 +1,153 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#ifndef SmiBendersSolver_HPP
+#define SmiBendersSolver_HPP
+
+#include "CoinPragma.hpp"
+#include "OsiSolverInterface.hpp"
+#include "SmiScnModel.hpp"
+#include "SmiScenarioWorkerPool.hpp"
+
+#include <vector>
+
+class SmiBendersWork;
+class SmiBendersEvaluate;
+
+//#############################################################################
+
+/** SmiBendersSolver: L-shaped decomposition of two-stage models
+
+Solves the two-stage model held by an SmiScnModel without generating
+the deterministic equivalent. The master problem holds the stage 0
+columns and rows of the core and one (single-cut) or one per scenario
+(multi-cut) recourse variable theta. Scenario subproblems hold the
+stage 1 columns and rows; they are built from the leaf node data one
+at a time, so memory does not grow with the number of scenarios.
+
+Optimality cuts are generated from the subproblem duals. Infeasible
+subproblems are replaced by their elastic form (one slack of each sign
+per row, unit cost) and give feasibility cuts. Master and subproblems
+are solved as LPs, minimizing.
+
+The subproblems of an iteration are solved by getNumThreads() workers
+(see SmiScenarioWorkerPool). Each subproblem resolves from its own basis
+of the previous iteration, kept per scenario (a few bits per row and
+column), whichever worker solves it. Cuts are built from the results in
+scenario order, so the iterates do not depend on the number of threads.
+
+Typical driver fragment looks like this
+\code
+SmiScnModel smi;
+smi.readSmps("bug");
+OsiClpSolverInterface clp;
+SmiBendersSolver benders(&smi,&clp);
+benders.setMultiCut(true);
+if (benders.solve() == 0)
+	printf("%g\n",benders.getObjValue());
+\endcode
+*/
+class SmiBendersSolver
+{
+public:
+
+    /**@name Constructor and destructor
+
+    osi is cloned for the master and for the subproblems.
+    */
+    //@{
+    SmiBendersSolver(SmiScnModel *smi, OsiSolverInterface *osi);
+    ~SmiBendersSolver();
+    //@}
+
+    /**@name Parameters */
+    //@{
+    /// one recourse variable per scenario (default false: a single one)
+    void setMultiCut(bool b) { multiCut_ = b; }
+    bool getMultiCut() { return multiCut_; }
+    /// maximum number of master solves (default 1000)
+    void setMaxIterations(int n) { maxIter_ = n; }
+    int getMaxIterations() { return maxIter_; }
+    /// relative gap between the bounds at which solve stops (default 1e-6)
+    void setOptimalityGap(double g) { gapTol_ = g; }
+    double getOptimalityGap() { return gapTol_; }
+    /// lower bound on the recourse variables once they have a cut (default -infinity)
+    void setThetaLowerBound(double lb) { thetaLb_ = lb; }
+    double getThetaLowerBound() { return thetaLb_; }
+    /// number of subproblem solvers (default SmiScnModel::getNumThreads())
+    void setNumThreads(int n) { numThreads_ = n; }
+    int getNumThreads() { return numThreads_; }
+    //@}
+
+    /**@name Solve
+
+    Returns 0 when the gap is closed, 1 when the iteration limit is
+    reached and -1 when the master is infeasible or unbounded, or a
+    subproblem cannot be solved.
+    */
+    //@{
+    int solve();
+    //@}
+
+    /**@name Results */
+    //@{
+    /// objective value of the best stage 0 solution found (upper bound)
+    double getObjValue() { return upperBound_; }
+    double getLowerBound() { return lowerBound_; }
+    double getUpperBound() { return upperBound_; }
+    /// best stage 0 solution, in core column order
+    const double *getColSolution() { return bestX_.empty() ? NULL : &bestX_[0]; }
+    int getNumIterations() { return numIter_; }
+    int getNumOptimalityCuts() { return numOptCuts_; }
+    int getNumFeasibilityCuts() { return numFeasCuts_; }
+    OsiSolverInterface *getMasterSolver() { return master_; }
+    //@}
+
+private:
+    friend class SmiBendersEvaluate;
+
+    /// loads stage 0 data and the recourse variables into master_
+    void buildMaster();
+    /** Solves the subproblem of scenario is for stage 0 solution x.
+        Returns 0 with the recourse value and its subgradient in value and grad,
+        1 with the elastic value and its subgradient (feasibility cut), or -1. */
+    int evaluateScenario(OsiSolverInterface *sub, SmiBendersWork &w, CoinWarmStart *&basis,
+        int is, const double *x, double &value, double *grad);
+    /// adds theta - grad x >= value - grad x to the master, freeing theta on its first cut
+    void addOptimalityCut(int theta, double value, const double *grad, const double *x);
+    /// adds value + grad (x' - x) <= 0 to the master
+    void addFeasibilityCut(double value, const double *grad, const double *x);
+
+private:
+    SmiScnModel *smi_;
+    SmiCoreData *core_;
+    OsiSolverInterface *master_;
+    // cloned for the subproblem workers
+    OsiSolverInterface *sub_;
+
+    // dimensions of the stages in the core
+    int ncol0_;
+    int nrow0_;
+    int ncol1_;
+    int nrow1_;
+
+    // normalized scenario probabilities
+    std::vector<double> prob_;
+    // recourse variables have had a cut
+    std::vector<bool> thetaFree_;
+
+    bool multiCut_;
+    int maxIter_;
+    double gapTol_;
+    double thetaLb_;
+    int numThreads_;
+
+    double lowerBound_;
+    double upperBound_;
+    std::vector<double> bestX_;
+    int numIter_;
+    int numOptCuts_;
+    int numFeasCuts_;
+};
+
+#endif //SmiBendersSolver_HPP
@@ -138,6 +138,42 @@ int SmiCoreCombineReplace::Process(double *dr,const int dr_len,const int nels, c
 	return numels;
 }
 
+int SmiCoreCombineReplace::Process(const int cr_len,const int *cr_ind,const double *cr_els,const int nels,const int *cpv_ind,const double *cpv_els,double *dels,int *indx)
+{
+
+	int numels=0;
+	int i=0,j=0;
+
+	// merge-join of sorted core row and sorted stochastic row
+	while (i<cr_len || j<nels)
+	{
+		int k;
+		double d;
+		if (j==nels || (i<cr_len && cr_ind[i]<cpv_ind[j]))
+		{
+			k=cr_ind[i];
+			d=cr_els[i++];
+		}
+		else
+		{
+			k=cpv_ind[j];
+			if (i<cr_len && cr_ind[i]==k)
+				i++;
+			// last stochastic value wins, as in the dense version
+			d=cpv_els[j++];
+			while (j<nels && cpv_ind[j]==k)
+				d=cpv_els[j++];
+		}
+		if (d)
+		{
+			dels[numels]=d;
+			indx[numels]=k;
+			numels++;
+		}
+	}
+	return numels;
+}
+
 //////////////////////////////////////////////////////////////////////
 // SmiCoreCombineReplace
 //////////////////////////////////////////////////////////////////////
@@ -269,4 +305,37 @@ int SmiCoreCombineAdd::Process(double *dr,const int dr_len,const int nels, const
 	}
 	return numels;
 }
+int SmiCoreCombineAdd::Process(const int cr_len,const int *cr_ind,const double *cr_els,const int nels,const int *cpv_ind,const double *cpv_els,double *dels,int *indx)
+{
+
+	int numels=0;
+	int i=0,j=0;
 
+	// merge-join of sorted core row and sorted stochastic row
+	while (i<cr_len || j<nels)
+	{
+		int k;
+		double d;
+		if (j==nels || (i<cr_len && cr_ind[i]<cpv_ind[j]))
+		{
+			k=cr_ind[i];
+			d=cr_els[i++];
+		}
+		else
+		{
+			k=cpv_ind[j];
+			d=0.0;
+			if (i<cr_len && cr_ind[i]==k)
+				d=cr_els[i++];
+			while (j<nels && cpv_ind[j]==k)
+				d+=cpv_els[j++];
+		}
+		if (d)
+		{
+			dels[numels]=d;
+			indx[numels]=k;
+			numels++;
+		}
+	}
+	return numels;
+}
@@ -44,6 +44,12 @@ public:
 	virtual CoinPackedVector * Process(CoinPackedVector *cpv1, CoinPackedVector *cpv2, char *type=0)=0;
 	virtual int Process(double *dr,const int dr_len,CoinPackedVector *cpv,double *dels,int *indx)=0;
 	virtual int Process(double *dr,const int dr_len,const int cpv_nels,const int* cpv_ind,const double *cpv_els,double *dels,int *indx)=0;
+	/** Sparse merge of a core row with a stochastic row, both with indices sorted
+		in increasing order.  Zeros are dropped, as in the dense Process.
+		Returns the number of elements written to dels/indx,
+		or -1 if the rule has no sparse path (caller should use the dense one). */
+	virtual int Process(const int /*cr_len*/,const int * /*cr_ind*/,const double * /*cr_els*/,const int /*cpv_nels*/,const int* /*cpv_ind*/,const double * /*cpv_els*/,double * /*dels*/,int * /*indx*/){return -1;}
+	//@}
 	virtual ~SmiCoreCombineRule(){}
 };
 
@@ -62,6 +68,7 @@ public:
 	virtual CoinPackedVector * Process(CoinPackedVector *cpv1, CoinPackedVector *cpv2, char *type=0);
 	virtual int Process(double *dr,const int dr_len,CoinPackedVector *cpv,double *dels,int *indx);
 	virtual int Process(double *dr,const int dr_len,const int nels, const int* cpv_ind,const double *cpv_els,double *dels,int *indx);
+	virtual int Process(const int cr_len,const int *cr_ind,const double *cr_els,const int nels,const int* cpv_ind,const double *cpv_els,double *dels,int *indx);
 protected:
 	SmiCoreCombineReplace(){}
 private:
@@ -82,6 +89,7 @@ public:
 	virtual CoinPackedVector * Process(CoinPackedVector *cpv1, CoinPackedVector *cpv2, char* type=0);
 	virtual int Process(double *dr,const int dr_len,CoinPackedVector *cpv,double *dels,int *indx);
 	virtual int Process(double *dr,const int dr_len,const int nels, const int* cpv_ind,const double *cpv_els,double *dels,int *indx);
+	virtual int Process(const int cr_len,const int *cr_ind,const double *cr_els,const int nels,const int* cpv_ind,const double *cpv_els,double *dels,int *indx);
 protected:
 	SmiCoreCombineAdd(){}
 private:
@@ -0,0 +1,708 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#include "SmiNestedBendersSolver.hpp"
+#include "CoinPackedMatrix.hpp"
+#include "CoinHelperFunctions.hpp"
+#include <assert.h>
+#include <math.h>
+
+using namespace std;
+
+//#############################################################################
+// Cuts, tree nodes and stage solvers
+//#############################################################################
+
+class SmiNestedCut
+{
+public:
+    // theta >= alpha + beta x (optimality) or 0 >= alpha + beta x (feasibility);
+    // x holds the columns of the node and its ancestors, in core positions
+    double alpha;
+    vector<int> ind;
+    vector<double> els;
+    bool optimality;
+};
+
+class SmiNestedNode
+{
+public:
+    SmiNestedNode(SmiScnNode *n):
+        node(n),parent(-1),childBegin(0),childEnd(0),prob(0.0),
+        theta(0.0),thetaFree(false),cost(0.0),feasible(false) {}
+
+    SmiScnNode *node;
+    // index of the parent in the previous stage, children in the next one
+    int parent;
+    int childBegin;
+    int childEnd;
+    // normalized probability
+    double prob;
+
+    // last feasible solve: stage columns, recourse variable, stage cost
+    vector<double> x;
+    double theta;
+    bool thetaFree;
+    double cost;
+    bool feasible;
+
+    // cuts passed up by the children
+    vector<SmiNestedCut> cuts;
+};
+
+class SmiNestedStage
+{
+public:
+    SmiNestedStage(SmiCoreData *core, int t):
+        osi(NULL),loaded(-1),solved(false),cutsLoaded(0)
+    {
+        ncol = core->getNumCols(t);
+        nrow = core->getNumRows(t);
+        col0 = core->getColStart(t);
+        row0 = core->getRowStart(t);
+        hasTheta = t < core->getNumStages()-1;
+        slack0 = ncol + (hasTheta ? 1 : 0);
+        cutSlack = slack0 + 2*nrow;
+        clo.resize(ncol);
+        cup.resize(ncol);
+        obj.resize(ncol);
+        rlo.resize(nrow);
+        rup.resize(nrow);
+        srlo.resize(nrow);
+        srup.resize(nrow);
+        rstrt.resize(nrow+1);
+        nclo.resize(ncol);
+        ncup.resize(ncol);
+        nobj.resize(ncol);
+        nrlo.resize(nrow);
+        nrup.resize(nrow);
+        nrstrt.resize(nrow+1);
+        xanc.resize(col0+1);
+        denseRow = new double[core->getNumCols()+1];
+    }
+    ~SmiNestedStage()
+    {
+        delete osi;
+        delete [] denseRow;
+    }
+
+    /// elastic form: stage costs off, slacks on
+    void setElastic(bool on)
+    {
+        double inf = osi->getInfinity();
+        for (int j=0; j<ncol; ++j)
+            osi->setObjCoeff(j,on ? 0.0 : obj[j]);
+        if (hasTheta)
+            osi->setObjCoeff(ncol,on ? 0.0 : 1.0);
+        for (int s=0; s<2*nrow; ++s)
+            osi->setColBounds(slack0+s,0.0,on ? inf : 0.0);
+        osi->setColBounds(cutSlack,0.0,on ? inf : 0.0);
+    }
+
+    OsiSolverInterface *osi;
+    // stage dimensions and offsets in the core
+    int ncol;
+    int nrow;
+    int col0;
+    int row0;
+    // columns: stage columns, theta (not in the last stage), slacks s+ and s-,
+    // and the slack of the feasibility cuts
+    bool hasTheta;
+    int slack0;
+    int cutSlack;
+
+    // node in the solver and its data: bounds, objective, row bounds
+    // before and after the ancestor shift, rows in core column positions
+    int loaded;
+    bool solved;
+    vector<double> clo;
+    vector<double> cup;
+    vector<double> obj;
+    vector<double> rlo;
+    vector<double> rup;
+    vector<double> srlo;
+    vector<double> srup;
+    vector<double> dels;
+    vector<int> indx;
+    vector<int> rstrt;
+    // cut rows follow the stage rows
+    int cutsLoaded;
+    vector<double> cutRhs;
+
+    // data of the next node
+    vector<double> nclo;
+    vector<double> ncup;
+    vector<double> nobj;
+    vector<double> nrlo;
+    vector<double> nrup;
+    vector<double> ndels;
+    vector<int> nindx;
+    vector<int> nrstrt;
+
+    // ancestor columns of the loaded node
+    vector<double> xanc;
+    double *denseRow;
+};
+
+//#############################################################################
+
+SmiNestedBendersSolver::SmiNestedBendersSolver(SmiScnModel *smi, OsiSolverInterface *osi):
+    smi_(smi),core_(NULL),nstages_(0),direction_(1),
+    protocol_(FastForwardFastBack),maxIter_(10000),gapTol_(1.0e-6),thetaLb_(-osi->getInfinity()),
+    lowerBound_(-osi->getInfinity()),upperBound_(osi->getInfinity()),
+    numIter_(0),numOptCuts_(0),numFeasCuts_(0)
+{
+    // the core of the tree; getCore() is only set by readSmps
+    core_ = smi_->getRootNode()->getNode()->getCore();
+    nstages_ = core_->getNumStages();
+    assert(nstages_ > 1);
+    for (int t=0; t<nstages_; ++t)
+    {
+        SmiNestedStage *st = new SmiNestedStage(core_,t);
+        st->osi = osi->clone(false);
+        stages_.push_back(st);
+    }
+}
+
+SmiNestedBendersSolver::~SmiNestedBendersSolver()
+{
+    for (unsigned int t=0; t<stages_.size(); ++t)
+        delete stages_[t];
+    for (unsigned int t=0; t<nodes_.size(); ++t)
+        for (unsigned int k=0; k<nodes_[t].size(); ++k)
+            delete nodes_[t][k];
+}
+
+void
+SmiNestedBendersSolver::buildStages()
+{
+    for (unsigned int t=0; t<nodes_.size(); ++t)
+        for (unsigned int k=0; k<nodes_[t].size(); ++k)
+            delete nodes_[t][k];
+    nodes_.assign(nstages_,vector<SmiNestedNode *>());
+
+    // tree nodes by stage; the children of a node are contiguous
+    SmiScenarioTree<SmiScnNode *> *tree = smi_->getSmiTree();
+    double rootProb = tree->getRoot()->getDataPtr()->getProb();
+    vector< SmiTreeNode<SmiScnNode *> * > level(1,tree->getRoot());
+    vector< SmiTreeNode<SmiScnNode *> * > next;
+    for (int t=0; t<nstages_; ++t)
+    {
+        assert(!level.empty());
+        next.clear();
+        for (unsigned int k=0; k<level.size(); ++k)
+        {
+            SmiNestedNode *nd = new SmiNestedNode(level[k]->getDataPtr());
+            assert(nd->node->getStage() == t);
+            nd->prob = nd->node->getProb()/rootProb;
+            nd->childBegin = static_cast<int>(next.size());
+            for (SmiTreeNode<SmiScnNode *> *c = level[k]->getChild(); c; c = c->getSibling())
+                next.push_back(c);
+            nd->childEnd = static_cast<int>(next.size());
+            nodes_[t].push_back(nd);
+        }
+        if (t)
+        {
+            for (unsigned int p=0; p<nodes_[t-1].size(); ++p)
+                for (int k=nodes_[t-1][p]->childBegin; k<nodes_[t-1][p]->childEnd; ++k)
+                    nodes_[t][k]->parent = p;
+        }
+        level.swap(next);
+    }
+
+    // stage solvers: first node of the stage, slacks and theta fixed at zero
+    for (int t=0; t<nstages_; ++t)
+    {
+        SmiNestedStage *st = stages_[t];
+        int nels = smi_->fillNodeArrays(nodes_[t][0]->node,&st->clo[0],&st->cup[0],&st->obj[0],
+            &st->rlo[0],&st->rup[0],st->dels,st->indx,&st->rstrt[0],st->denseRow);
+        int ncol = st->cutSlack+1;
+
+        // stage part of the rows, and the slacks
+        vector<double> els;
+        vector<int> ind;
+        vector<int> strt(1,0);
+        els.reserve(nels+2*st->nrow);
+        ind.reserve(nels+2*st->nrow);
+        for (int r=0; r<st->nrow; ++r)
+        {
+            for (int e=st->rstrt[r]; e<st->rstrt[r+1]; ++e)
+            {
+                if (st->indx[e] >= st->col0)
+                {
+                    els.push_back(st->dels[e]);
+                    ind.push_back(st->indx[e]-st->col0);
+                }
+            }
+            els.push_back(1.0);
+            ind.push_back(st->slack0+r);
+            els.push_back(-1.0);
+            ind.push_back(st->slack0+st->nrow+r);
+            strt.push_back(static_cast<int>(els.size()));
+        }
+        vector<double> clo(st->clo);
+        vector<double> cup(st->cup);
+        vector<double> obj(st->obj);
+        clo.resize(ncol,0.0);
+        cup.resize(ncol,0.0);
+        obj.resize(ncol,1.0);
+        st->srlo = st->rlo;
+        st->srup = st->rup;
+        CoinPackedMatrix matrix(false,ncol,st->nrow,static_cast<int>(els.size()),
+            els.empty() ? NULL : &els[0],ind.empty() ? NULL : &ind[0],&strt[0],NULL);
+        st->osi->loadProblem(matrix,&clo[0],&cup[0],&obj[0],
+            st->nrow ? &st->srlo[0] : NULL,st->nrow ? &st->srup[0] : NULL);
+        st->osi->setObjSense(1.0);
+        st->loaded = 0;
+        st->solved = false;
+        st->cutsLoaded = 0;
+        st->cutRhs.clear();
+    }
+
+    stale_.assign(nstages_,true);
+    changed_.assign(nstages_,false);
+    direction_ = 1;
+    lowerBound_ = -stages_[0]->osi->getInfinity();
+    upperBound_ = stages_[0]->osi->getInfinity();
+    bestX_.clear();
+    numIter_ = 0;
+    numOptCuts_ = 0;
+    numFeasCuts_ = 0;
+}
+
+void
+SmiNestedBendersSolver::getAncestorCols(int t, int k, double *xanc)
+{
+    int p = nodes_[t][k]->parent;
+    for (int s=t-1; s>=0; --s)
+    {
+        SmiNestedNode *a = nodes_[s][p];
+        assert(static_cast<int>(a->x.size()) == core_->getNumCols(s));
+        CoinCopyN(&a->x[0],core_->getNumCols(s),xanc+core_->getColStart(s));
+        p = a->parent;
+    }
+}
+
+void
+SmiNestedBendersSolver::loadNode(int t, int k)
+{
+    SmiNestedStage *st = stages_[t];
+    SmiNestedNode *nd = nodes_[t][k];
+    OsiSolverInterface *osi = st->osi;
+    double inf = osi->getInfinity();
+    int col0 = st->col0;
+    getAncestorCols(t,k,&st->xanc[0]);
+
+    if (st->loaded != k)
+    {
+        SmiNodeData *onode = nodes_[t][st->loaded]->node->getNode();
+        SmiNodeData *nnode = nd->node->getNode();
+        smi_->fillNodeArrays(nd->node,&st->nclo[0],&st->ncup[0],&st->nobj[0],&st->nrlo[0],&st->nrup[0],
+            st->ndels,st->nindx,&st->nrstrt[0],st->denseRow);
+
+        // bounds and objective
+        for (int j=0; j<st->ncol; ++j)
+        {
+            if (st->nclo[j] != st->clo[j] || st->ncup[j] != st->cup[j])
+                osi->setColBounds(j,st->nclo[j],st->ncup[j]);
+            if (st->nobj[j] != st->obj[j])
+                osi->setObjCoeff(j,st->nobj[j]);
+        }
+
+        // stage part of the rows with stochastic entries in either node;
+        // merge-join of the sorted rows, a dropped entry is set to zero
+        for (int r=0; r<st->nrow; ++r)
+        {
+            int i = st->row0+r;
+            if (!onode->getRowLength(i) && !nnode->getRowLength(i))
+                continue;
+            int a = st->rstrt[r], aend = st->rstrt[r+1];
+            int b = st->nrstrt[r], bend = st->nrstrt[r+1];
+            while (a < aend && st->indx[a] < col0)
+                a++;
+            while (b < bend && st->nindx[b] < col0)
+                b++;
+            while (a < aend || b < bend)
+            {
+                if (b == bend || (a < aend && st->indx[a] < st->nindx[b]))
+                {
+                    osi->modifyCoefficient(r,st->indx[a]-col0,0.0);
+                    a++;
+                }
+                else if (a == aend || st->nindx[b] < st->indx[a])
+                {
+                    osi->modifyCoefficient(r,st->nindx[b]-col0,st->ndels[b]);
+                    b++;
+                }
+                else
+                {
+                    if (st->dels[a] != st->ndels[b])
+                        osi->modifyCoefficient(r,st->nindx[b]-col0,st->ndels[b]);
+                    a++;
+                    b++;
+                }
+            }
+        }
+        st->clo.swap(st->nclo);
+        st->cup.swap(st->ncup);
+        st->obj.swap(st->nobj);
+        st->rlo.swap(st->nrlo);
+        st->rup.swap(st->nrup);
+        st->dels.swap(st->ndels);
+        st->indx.swap(st->nindx);
+        st->rstrt.swap(st->nrstrt);
+
+        // cut rows belong to the node
+        if (st->cutsLoaded)
+        {
+            vector<int> del(st->cutsLoaded);
+            for (int c=0; c<st->cutsLoaded; ++c)
+                del[c] = st->nrow+c;
+            osi->deleteRows(st->cutsLoaded,&del[0]);
+            st->cutsLoaded = 0;
+            st->cutRhs.clear();
+        }
+        st->loaded = k;
+    }
+
+    if (st->hasTheta)
+    {
+        if (nd->thetaFree)
+            osi->setColBounds(st->ncol,thetaLb_,inf);
+        else
+            osi->setColBounds(st->ncol,0.0,0.0);
+    }
+
+    // row bounds shifted by the ancestor columns
+    for (int r=0; r<st->nrow; ++r)
+    {
+        double tx = 0.0;
+        for (int e=st->rstrt[r]; e<st->rstrt[r+1]; ++e)
+        {
+            if (st->indx[e] < col0)
+                tx += st->dels[e]*st->xanc[st->indx[e]];
+        }
+        double lo = st->rlo[r] > -inf ? st->rlo[r]-tx : -inf;
+        double up = st->rup[r] < inf ? st->rup[r]-tx : inf;
+        if (lo != st->srlo[r] || up != st->srup[r])
+        {
+            osi->setRowBounds(r,lo,up);
+            st->srlo[r] = lo;
+            st->srup[r] = up;
+        }
+    }
+
+    // cuts: the ancestor part goes to the right hand side
+    int ncuts = static_cast<int>(nd->cuts.size());
+    vector<int> ind;
+    vector<double> els;
+    for (int c=0; c<ncuts; ++c)
+    {
+        SmiNestedCut &cut = nd->cuts[c];
+        double rhs = cut.alpha;
+        int n = static_cast<int>(cut.ind.size());
+        for (int e=0; e<n; ++e)
+        {
+            if (cut.ind[e] < col0)
+                rhs += cut.els[e]*st->xanc[cut.ind[e]];
+        }
+        if (c < st->cutsLoaded)
+        {
+            if (rhs != st->cutRhs[c])
+            {
+                osi->setRowBounds(st->nrow+c,rhs,inf);
+                st->cutRhs[c] = rhs;
+            }
+            continue;
+        }
+        ind.clear();
+        els.clear();
+        for (int e=0; e<n; ++e)
+        {
+            if (cut.ind[e] >= col0)
+            {
+                ind.push_back(cut.ind[e]-col0);
+                els.push_back(-cut.els[e]);
+            }
+        }
+        if (cut.optimality)
+        {
+            ind.push_back(st->ncol);
+            els.push_back(1.0);
+        }
+        else
+        {
+            // the cuts of the children may be all that makes the node infeasible
+            ind.push_back(st->cutSlack);
+            els.push_back(1.0);
+        }
+        osi->addRow(static_cast<int>(ind.size()),ind.empty() ? NULL : &ind[0],els.empty() ? NULL : &els[0],rhs,inf);
+        st->cutRhs.push_back(rhs);
+    }
+    st->cutsLoaded = ncuts;
+}
+
+int
+SmiNestedBendersSolver::solveStage(int t, bool &infeasible, bool &changedX)
+{
+    SmiNestedStage *st = stages_[t];
+    OsiSolverInterface *osi = st->osi;
+    int nnodes = static_cast<int>(nodes_[t].size());
+    int col0 = st->col0;
+    infeasible = false;
+    changedX = false;
+
+    // value gradient of one node in the ancestor columns, and the
+    // probability weighted sum over the children of one parent
+    vector<double> grad(col0+1);
+    vector<double> agg(col0+1,0.0);
+    double aggValue = 0.0;
+    bool aggValid = true;
+
+    for (int k=0; k<nnodes; ++k)
+    {
+        SmiNestedNode *nd = nodes_[t][k];
+        loadNode(t,k);
+        if (st->solved)
+            osi->resolve();
+        else
+            osi->initialSolve();
+        st->solved = true;
+
+        int status = 0;
+        if (osi->isProvenPrimalInfeasible())
+        {
+            // no ancestors to cut off at the root
+            if (!t)
+                return -1;
+            st->setElastic(true);
+            osi->resolve();
+            status = 1;
+        }
+        if (!osi->isProvenOptimal())
+        {
+            if (status)
+                st->setElastic(false);
+            return -1;
+        }
+
+        const double *sol = osi->getColSolution();
+        double value = osi->getObjValue();
+        if (!status)
+        {
+            for (int j=0; j<st->ncol && !changedX; ++j)
+                changedX = nd->x.empty() || fabs(sol[j]-nd->x[j]) > 1.0e-7*(1.0+fabs(sol[j]));
+            nd->x.assign(sol,sol+st->ncol);
+            nd->theta = st->hasTheta ? sol[st->ncol] : 0.0;
+            nd->cost = value-nd->theta;
+            nd->feasible = true;
+            if (!t && nd->thetaFree)
+                lowerBound_ = CoinMax(lowerBound_,value);
+        }
+        else
+        {
+            nd->feasible = false;
+            infeasible = true;
+        }
+
+        if (t)
+        {
+            // the stage rows move by -T x, the cut rows by beta x
+            const double *pi = osi->getRowPrice();
+            CoinFillN(&grad[0],col0,0.0);
+            for (int r=0; r<st->nrow; ++r)
+            {
+                if (!pi[r])
+                    continue;
+                for (int e=st->rstrt[r]; e<st->rstrt[r+1]; ++e)
+                {
+                    if (st->indx[e] < col0)
+                        grad[st->indx[e]] -= pi[r]*st->dels[e];
+                }
+            }
+            for (int c=0; c<st->cutsLoaded; ++c)
+            {
+                double p = pi[st->nrow+c];
+                if (!p)
+                    continue;
+                SmiNestedCut &cut = nd->cuts[c];
+                for (unsigned int e=0; e<cut.ind.size(); ++e)
+                {
+                    if (cut.ind[e] < col0)
+                        grad[cut.ind[e]] += p*cut.els[e];
+                }
+            }
+
+            SmiNestedNode *par = nodes_[t-1][nd->parent];
+            if (status)
+            {
+                // value + grad (x' - x) <= 0
+                SmiNestedCut cut;
+                cut.alpha = value;
+                cut.optimality = false;
+                for (int j=0; j<col0; ++j)
+                {
+                    if (grad[j])
+                    {
+                        cut.alpha -= grad[j]*st->xanc[j];
+                        cut.ind.push_back(j);
+                        cut.els.push_back(grad[j]);
+                    }
+                }
+                par->cuts.push_back(cut);
+                changed_[t-1] = true;
+                numFeasCuts_++;
+                aggValid = false;
+            }
+            else
+            {
+                // a node's value bounds its recourse once its theta has a cut
+                double q = nd->prob/par->prob;
+                aggValue += q*value;
+                for (int j=0; j<col0; ++j)
+                    agg[j] += q*grad[j];
+                aggValid = aggValid && (!st->hasTheta || nd->thetaFree);
+            }
+
+            // last child of the parent: theta >= aggValue + agg (x' - x)
+            if (k+1 == par->childEnd)
+            {
+                double tol = gapTol_*(1.0+fabs(aggValue));
+                if (aggValid && (!par->thetaFree || par->theta < aggValue-tol))
+                {
+                    SmiNestedCut cut;
+                    cut.alpha = aggValue;
+                    cut.optimality = true;
+                    for (int j=0; j<col0; ++j)
+                    {
+                        if (agg[j])
+                        {
+                            cut.alpha -= agg[j]*st->xanc[j];
+                            cut.ind.push_back(j);
+                            cut.els.push_back(agg[j]);
+                        }
+                    }
+                    par->cuts.push_back(cut);
+                    par->thetaFree = true;
+                    changed_[t-1] = true;
+                    numOptCuts_++;
+                }
+                CoinFillN(&agg[0],col0,0.0);
+                aggValue = 0.0;
+                aggValid = true;
+            }
+        }
+
+        if (status)
+            st->setElastic(false);
+    }
+    return 0;
+}
+
+int
+SmiNestedBendersSolver::nextStage(int t, bool infeasible)
+{
+    if (infeasible)
+        return t-1;
+
+    int firstStale = -1;
+    int lastChanged = -1;
+    for (int s=0; s<nstages_; ++s)
+    {
+        if (stale_[s] && firstStale < 0)
+            firstStale = s;
+        if (changed_[s])
+            lastChanged = s;
+    }
+    if (firstStale < 0 && lastChanged < 0)
+        return -1;
+
+    switch (protocol_)
+    {
+    case FastForwardFastBack:
+        if (t == nstages_-1)
+            direction_ = -1;
+        else if (!t)
+            direction_ = 1;
+        return t+direction_;
+    case FastBack:
+        if (t && changed_[t-1])
+            return t-1;
+        return firstStale >= 0 ? firstStale : lastChanged;
+    default:
+        return firstStale >= 0 ? firstStale : lastChanged;
+    }
+}
+
+void
+SmiNestedBendersSolver::updateUpperBound()
+{
+    // only a complete set of solutions for the current ancestors is feasible
+    for (int t=0; t<nstages_; ++t)
+    {
+        if (stale_[t])
+            return;
+    }
+    double z = 0.0;
+    for (int t=0; t<nstages_; ++t)
+    {
+        for (unsigned int k=0; k<nodes_[t].size(); ++k)
+        {
+            SmiNestedNode *nd = nodes_[t][k];
+            if (!nd->feasible)
+                return;
+            z += nd->prob*nd->cost;
+        }
+    }
+    if (z < upperBound_)
+    {
+        upperBound_ = z;
+        bestX_ = nodes_[0][0]->x;
+    }
+}
+
+int
+SmiNestedBendersSolver::solve()
+{
+    buildStages();
+
+    int t = 0;
+    int rc = 1;
+    while (numIter_ < maxIter_)
+    {
+        bool infeasible, changedX;
+        if (solveStage(t,infeasible,changedX) < 0)
+        {
+            rc = -1;
+            break;
+        }
+        numIter_++;
+
+        // a stage with infeasible nodes is solved again after its parents move
+        stale_[t] = infeasible;
+        changed_[t] = false;
+        if (changedX)
+        {
+            for (int s=t+1; s<nstages_; ++s)
+                stale_[s] = true;
+        }
+        if (!infeasible)
+            updateUpperBound();
+        if (upperBound_ < stages_[0]->osi->getInfinity() &&
+            upperBound_-lowerBound_ <= gapTol_*(1.0+fabs(upperBound_)))
+        {
+            rc = 0;
+            break;
+        }
+
+        t = nextStage(t,infeasible);
+        if (t < 0)
+        {
+            // every node is optimal for its ancestors and has no new cuts
+            lowerBound_ = CoinMin(lowerBound_,upperBound_);
+            rc = 0;
+            break;
+        }
+    }
+    return rc;
+}
@@ -0,0 +1,161 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#ifndef SmiNestedBendersSolver_HPP
+#define SmiNestedBendersSolver_HPP
+
+#include "CoinPragma.hpp"
+#include "OsiSolverInterface.hpp"
+#include "SmiScnModel.hpp"
+
+#include <vector>
+
+class SmiNestedStage;
+class SmiNestedNode;
+
+//#############################################################################
+
+/** SmiNestedBendersSolver: nested L-shaped decomposition of multistage models
+
+Solves the model held by an SmiScnModel one tree node at a time. The
+LP of a node holds the node's stage columns and rows, with the columns
+of its ancestors fixed at their current values, a recourse variable
+theta for the expected cost of its children (not in the last stage),
+and the cuts its children have passed up to it. Cuts are affine in all
+ancestor columns, so rows that reach back more than one stage are fine.
+
+There is one solver per stage, loaded from the core stage block. A node
+is loaded by applying only its differences from the node loaded before
+it: bounds and objective through setColBounds and setObjCoeff, rows
+with stochastic entries in either node through modifyCoefficient, and
+the row bounds shifted by the ancestor columns through setRowBounds.
+Cut rows are swapped when the node changes.
+
+Infeasible node LPs are solved in elastic form (one slack of each sign
+per stage row and one slack shared by the feasibility cut rows, unit
+cost) and give feasibility cuts to the parent, also when only the cuts
+of the children make them infeasible. All LPs are minimized.
+
+The order in which stages are solved is set by the sequencing protocol:
+ - FastForwardFastBack: full sweeps, forward to the last stage and back to the root.
+ - FastForward: go forward whenever a stage has out of date solutions,
+   back to the latest stage with new cuts otherwise.
+ - FastBack: go back whenever the stage just solved has added cuts to
+   its parent, forward otherwise.
+
+All protocols go back from a stage with infeasible nodes. solve() stops
+when the bounds meet, or when no stage has new cuts or out of date
+solutions.
+
+Typical driver fragment looks like this
+\code
+SmiScnModel smi;
+smi.readSmps("app0110");
+OsiClpSolverInterface clp;
+SmiNestedBendersSolver nested(&smi,&clp);
+nested.setProtocol(SmiNestedBendersSolver::FastForwardFastBack);
+if (nested.solve() == 0)
+	printf("%g\n",nested.getObjValue());
+\endcode
+*/
+class SmiNestedBendersSolver
+{
+public:
+
+    /// sequencing protocols
+    enum Protocol { FastForward, FastBack, FastForwardFastBack };
+
+    /**@name Constructor and destructor
+
+    osi is cloned once per stage.
+    */
+    //@{
+    SmiNestedBendersSolver(SmiScnModel *smi, OsiSolverInterface *osi);
+    ~SmiNestedBendersSolver();
+    //@}
+
+    /**@name Parameters */
+    //@{
+    /// order in which stages are solved (default FastForwardFastBack)
+    void setProtocol(Protocol p) { protocol_ = p; }
+    Protocol getProtocol() { return protocol_; }
+    /// maximum number of stage solves (default 10000)
+    void setMaxIterations(int n) { maxIter_ = n; }
+    int getMaxIterations() { return maxIter_; }
+    /// relative gap between the bounds at which solve stops (default 1e-6)
+    void setOptimalityGap(double g) { gapTol_ = g; }
+    double getOptimalityGap() { return gapTol_; }
+    /// lower bound on the recourse variables once they have a cut (default -infinity)
+    void setThetaLowerBound(double lb) { thetaLb_ = lb; }
+    double getThetaLowerBound() { return thetaLb_; }
+    //@}
+
+    /**@name Solve
+
+    Returns 0 when converged, 1 when the iteration limit is reached
+    and -1 when the root is infeasible or a node LP cannot be solved.
+    */
+    //@{
+    int solve();
+    //@}
+
+    /**@name Results */
+    //@{
+    /// expected cost of the best feasible solution found (upper bound)
+    double getObjValue() { return upperBound_; }
+    double getLowerBound() { return lowerBound_; }
+    double getUpperBound() { return upperBound_; }
+    /// stage 0 columns of the best solution, in core column order
+    const double *getColSolution() { return bestX_.empty() ? NULL : &bestX_[0]; }
+    /// number of stage solves
+    int getNumIterations() { return numIter_; }
+    int getNumOptimalityCuts() { return numOptCuts_; }
+    int getNumFeasibilityCuts() { return numFeasCuts_; }
+    int getNumStages() { return nstages_; }
+    //@}
+
+private:
+    /// collects the tree nodes by stage and builds the stage solvers
+    void buildStages();
+    /// loads node k of stage t into the stage solver, applying only its differences
+    void loadNode(int t, int k);
+    /** Solves every node of stage t and passes cuts to the parents.
+        Returns -1 on failure, otherwise sets the flags. */
+    int solveStage(int t, bool &infeasible, bool &changedX);
+    /// ancestor columns of node k of stage t, in core positions
+    void getAncestorCols(int t, int k, double *xanc);
+    /// next stage to solve after t, or -1 if there is nothing left to do
+    int nextStage(int t, bool infeasible);
+    /// expected cost of the current solutions, if they are all up to date
+    void updateUpperBound();
+
+private:
+    SmiScnModel *smi_;
+    SmiCoreData *core_;
+    int nstages_;
+
+    // stage solvers and tree nodes by stage
+    std::vector<SmiNestedStage *> stages_;
+    std::vector< std::vector<SmiNestedNode *> > nodes_;
+
+    // stage solutions computed for ancestors that have changed since
+    std::vector<bool> stale_;
+    // stage has cuts added since it was solved
+    std::vector<bool> changed_;
+    // direction of the sweep for FastForwardFastBack
+    int direction_;
+
+    Protocol protocol_;
+    int maxIter_;
+    double gapTol_;
+    double thetaLb_;
+
+    double lowerBound_;
+    double upperBound_;
+    std::vector<double> bestX_;
+    int numIter_;
+    int numOptCuts_;
+    int numFeasCuts_;
+};
+
+#endif //SmiNestedBendersSolver_HPP
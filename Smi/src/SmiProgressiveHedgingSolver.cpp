@@ -0,0 +1,506 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#include "SmiProgressiveHedgingSolver.hpp"
+#include "CoinPackedMatrix.hpp"
+#include "CoinHelperFunctions.hpp"
+#include "CoinWarmStart.hpp"
+#include <assert.h>
+#include <math.h>
+#include <map>
+
+using namespace std;
+
+//#############################################################################
+// Scenario problems and tree nodes
+//#############################################################################
+
+class SmiPHScenario
+{
+public:
+    SmiPHScenario():prob(0.0),value(0.0),basis(NULL) {}
+    ~SmiPHScenario() { delete basis; }
+
+    double prob;
+    // node of the scenario in each stage but the last
+    vector<int> node;
+
+    // current iterate, multipliers of the constrained columns, value of the last solve
+    vector<double> x;
+    vector<double> w;
+    double value;
+    // basis of the last iterate, LPs only
+    CoinWarmStart *basis;
+};
+
+// Work arrays of one worker: the scenario problem it is solving
+class SmiPHWork
+{
+public:
+    SmiPHWork(SmiCoreData *core)
+    {
+        int ncol = core->getNumCols();
+        int nrow = core->getNumRows();
+        clo.resize(ncol);
+        cup.resize(ncol);
+        obj.resize(ncol);
+        rlo.resize(nrow);
+        rup.resize(nrow);
+        rstrt.resize(nrow+1);
+        denseRow.resize(ncol+1);
+    }
+
+    // scenario problem in core positions (see SmiScnModel::fillScenarioArrays)
+    vector<double> clo;
+    vector<double> cup;
+    vector<double> obj;
+    vector<double> rlo;
+    vector<double> rup;
+    vector<int> rstrt;
+    vector<double> denseRow;
+    vector<double> dels;
+    vector<int> indx;
+
+    // penalty columns and their tangent rows
+    vector<int> pcol;
+    vector<double> plo;
+    vector<double> pup;
+    vector<double> pobj;
+    vector<int> pstrt;
+    vector<int> pind;
+    vector<double> pels;
+    vector<double> prlo;
+    vector<double> prup;
+};
+
+// Solves scenario problems on the workers of a pool
+class SmiPHSolve
+{
+public:
+    SmiPHSolve(SmiProgressiveHedgingSolver *ph, int mode, bool iterate, vector<int> &status):
+        ph_(ph),mode_(mode),iterate_(iterate),status_(status) {}
+
+    void operator() (OsiSolverInterface *osi, int worker, int is)
+    {
+        status_[is] = ph_->solveScenario(osi,*ph_->work_[worker],is,
+            static_cast<SmiProgressiveHedgingSolver::SolveMode>(mode_),iterate_);
+    }
+
+private:
+    SmiProgressiveHedgingSolver *ph_;
+    int mode_;
+    bool iterate_;
+    vector<int> &status_;
+};
+
+class SmiPHNode
+{
+public:
+    SmiPHNode(int t):stage(t),prob(0.0) {}
+
+    int stage;
+    double prob;
+    // average of the scenario solutions over the node, the previous one,
+    // and the largest distance of a scenario solution from it
+    vector<double> xbar;
+    vector<double> xbarOld;
+    vector<double> spread;
+};
+
+//#############################################################################
+
+SmiProgressiveHedgingSolver::SmiProgressiveHedgingSolver(SmiScnModel *smi, OsiSolverInterface *osi):
+    smi_(smi),core_(NULL),osi_(NULL),pool_(NULL),nNonant_(0),
+    rho_(1.0),adaptiveRho_(false),maxIter_(100),convTol_(1.0e-4),boundFreq_(0),numPieces_(4),
+    numThreads_(smi->getNumThreads()),
+    lowerBound_(-osi->getInfinity()),upperBound_(osi->getInfinity()),convergence_(osi->getInfinity()),numIter_(0)
+{
+    osi_ = osi->clone(false);
+
+    // the core of the tree; getCore() is only set by readSmps
+    core_ = smi_->getRootNode()->getNode()->getCore();
+}
+
+SmiProgressiveHedgingSolver::~SmiProgressiveHedgingSolver()
+{
+    for (unsigned int is=0; is<scenarios_.size(); ++is)
+        delete scenarios_[is];
+    for (unsigned int n=0; n<nodes_.size(); ++n)
+        delete nodes_[n];
+    for (unsigned int k=0; k<work_.size(); ++k)
+        delete work_[k];
+    delete pool_;
+    delete osi_;
+}
+
+const double *
+SmiProgressiveHedgingSolver::getColSolution()
+{
+    if (nodes_.empty() || nodes_[0]->xbar.empty())
+        return NULL;
+    return &nodes_[0]->xbar[0];
+}
+
+const double *
+SmiProgressiveHedgingSolver::getScenarioSolution(int is)
+{
+    if (is < 0 || is >= static_cast<int>(scenarios_.size()) || scenarios_[is]->x.empty())
+        return NULL;
+    return &scenarios_[is]->x[0];
+}
+
+void
+SmiProgressiveHedgingSolver::buildScenarios()
+{
+    for (unsigned int is=0; is<scenarios_.size(); ++is)
+        delete scenarios_[is];
+    for (unsigned int n=0; n<nodes_.size(); ++n)
+        delete nodes_[n];
+    for (unsigned int k=0; k<work_.size(); ++k)
+        delete work_[k];
+    delete pool_;
+    scenarios_.clear();
+    nodes_.clear();
+
+    int nscen = smi_->getNumScenarios();
+    int nstages = core_->getNumStages();
+    nNonant_ = core_->getColStart(nstages-1);
+    assert(numPieces_ > 0);
+
+    // solvers and work arrays, one per worker, kept for the run
+    pool_ = new SmiScenarioWorkerPool(osi_,numThreads_);
+    work_.resize(pool_->getNumWorkers());
+    for (unsigned int k=0; k<work_.size(); ++k)
+        work_[k] = new SmiPHWork(core_);
+
+    double totalProb = 0.0;
+    for (int is=0; is<nscen; ++is)
+        totalProb += smi_->getLeafNode(is)->getProb();
+
+    intCols_.clear();
+    isInt_.assign(core_->getNumCols(),false);
+    for (int t=0; t<nstages; ++t)
+    {
+        vector<int> stageInts = core_->getIntCols(t);
+        for (unsigned int i=0; i<stageInts.size(); ++i)
+        {
+            intCols_.push_back(stageInts[i]+core_->getColStart(t));
+            isInt_[intCols_.back()] = true;
+        }
+    }
+
+    vector<SmiScnNode *> path;
+    map<SmiScnNode *,int> nodeIndex;
+    for (int is=0; is<nscen; ++is)
+    {
+        SmiPHScenario *sc = new SmiPHScenario();
+        scenarios_.push_back(sc);
+        sc->prob = smi_->getLeafNode(is)->getProb()/totalProb;
+
+        // nonanticipativity: scenarios through the same node share its columns
+        smi_->getScenarioNodes(is,path);
+        for (int t=0; t<nstages-1; ++t)
+        {
+            map<SmiScnNode *,int>::iterator it = nodeIndex.find(path[t]);
+            if (it == nodeIndex.end())
+            {
+                SmiPHNode *nd = new SmiPHNode(t);
+                nd->xbar.assign(core_->getNumCols(t),0.0);
+                nd->xbarOld.assign(core_->getNumCols(t),0.0);
+                nd->spread.assign(core_->getNumCols(t),0.0);
+                it = nodeIndex.insert(make_pair(path[t],static_cast<int>(nodes_.size()))).first;
+                nodes_.push_back(nd);
+            }
+            sc->node.push_back(it->second);
+            nodes_[it->second]->prob += sc->prob;
+        }
+        sc->w.assign(nNonant_,0.0);
+    }
+}
+
+int
+SmiProgressiveHedgingSolver::solveScenario(OsiSolverInterface *osi, SmiPHWork &wk, int is, SolveMode mode, bool iterate)
+{
+    SmiPHScenario *sc = scenarios_[is];
+    int ncol = core_->getNumCols();
+    int nrow = core_->getNumRows();
+    double inf = osi->getInfinity();
+    int nels = smi_->fillScenarioArrays(is,&wk.clo[0],&wk.cup[0],&wk.obj[0],&wk.rlo[0],&wk.rup[0],
+        wk.dels,wk.indx,&wk.rstrt[0],&wk.denseRow[0]);
+
+    // penalty column of each non-binary constrained column, with its
+    // tangents at xbar + m h: p - 2 m h x >= -2 m h xbar - m^2 h^2; the
+    // rows are free when there is no penalty, so the shape of the problem,
+    // and its basis, stays the same
+    wk.pcol.assign(nNonant_,-1);
+    wk.plo.clear();
+    wk.pup.clear();
+    wk.pobj.clear();
+    wk.pstrt.assign(1,0);
+    wk.pind.clear();
+    wk.pels.clear();
+    wk.prlo.clear();
+    wk.prup.clear();
+    for (int j=0; j<nNonant_; ++j)
+    {
+        int t = core_->getColStage(j);
+        SmiPHNode *nd = nodes_[sc->node[t]];
+        double xb = nd->xbar[j-core_->getColStart(t)];
+
+        bool binary = isInt_[j] && wk.clo[j] == 0.0 && wk.cup[j] == 1.0;
+        if (mode != FixedSolve)
+            wk.obj[j] += sc->w[j];
+        if (mode == FixedSolve)
+        {
+            double v = isInt_[j] ? floor(xb+0.5) : xb;
+            v = CoinMax(wk.clo[j],CoinMin(wk.cup[j],v));
+            wk.clo[j] = v;
+            wk.cup[j] = v;
+        }
+
+        if (binary)
+        {
+            // binary: rho/2 (x - xbar)^2 = rho/2 (1 - 2 xbar) x + constant
+            if (mode == PenaltySolve)
+                wk.obj[j] += 0.5*rho_*(1.0-2.0*xb);
+            continue;
+        }
+        wk.pcol[j] = ncol+static_cast<int>(wk.plo.size());
+        wk.plo.push_back(0.0);
+        wk.pup.push_back(inf);
+        wk.pobj.push_back(mode == PenaltySolve ? 0.5*rho_ : 0.0);
+        double h = CoinMax(nd->spread[j-core_->getColStart(t)],1.0e-6*(1.0+fabs(xb)))/numPieces_;
+        for (int k=0; k<2*numPieces_; ++k)
+        {
+            int m = k < numPieces_ ? -(k+1) : k-numPieces_+1;
+            wk.pind.push_back(j);
+            wk.pels.push_back(-2.0*m*h);
+            wk.pind.push_back(wk.pcol[j]);
+            wk.pels.push_back(1.0);
+            wk.pstrt.push_back(static_cast<int>(wk.pind.size()));
+            wk.prlo.push_back(mode == PenaltySolve ? -2.0*m*h*xb-m*m*h*h : -inf);
+            wk.prup.push_back(inf);
+        }
+    }
+
+    CoinPackedMatrix matrix(false,ncol,nrow,nels,&wk.dels[0],&wk.indx[0],&wk.rstrt[0],NULL);
+    osi->loadProblem(matrix,&wk.clo[0],&wk.cup[0],&wk.obj[0],&wk.rlo[0],&wk.rup[0]);
+    osi->setObjSense(1.0);
+    for (unsigned int i=0; i<intCols_.size(); ++i)
+        osi->setInteger(intCols_[i]);
+    int npen = static_cast<int>(wk.plo.size());
+    if (npen)
+    {
+        vector<int> cstrt(npen+1,0);
+        int dummyRow = 0;
+        double dummyEl = 0.0;
+        osi->addCols(npen,&cstrt[0],&dummyRow,&dummyEl,&wk.plo[0],&wk.pup[0],&wk.pobj[0]);
+        osi->addRows(static_cast<int>(wk.prlo.size()),&wk.pstrt[0],&wk.pind[0],&wk.pels[0],&wk.prlo[0],&wk.prup[0]);
+    }
+
+    if (!intCols_.empty())
+        osi->branchAndBound();
+    else if (sc->basis)
+    {
+        // start from the basis of the scenario's last iterate
+        osi->setWarmStart(sc->basis);
+        osi->resolve();
+    }
+    else
+        osi->initialSolve();
+
+    int status = -1;
+    if (osi->isProvenOptimal())
+    {
+        status = 0;
+        sc->value = osi->getObjValue();
+        if (iterate)
+        {
+            const double *sol = osi->getColSolution();
+            sc->x.assign(sol,sol+ncol);
+            if (intCols_.empty())
+            {
+                delete sc->basis;
+                sc->basis = osi->getWarmStart();
+            }
+        }
+    }
+    return status;
+}
+
+int
+SmiProgressiveHedgingSolver::solveScenarios(SolveMode mode, bool iterate)
+{
+    int nscen = static_cast<int>(scenarios_.size());
+    vector<int> status(nscen);
+
+    // a scenario only writes its own results
+    SmiPHSolve f(this,mode,iterate,status);
+    pool_->run(nscen,f);
+
+    for (int is=0; is<nscen; ++is)
+    {
+        if (status[is] < 0)
+            return -1;
+    }
+    return 0;
+}
+
+double
+SmiProgressiveHedgingSolver::updateAverages(double &change)
+{
+    int nscen = static_cast<int>(scenarios_.size());
+    for (unsigned int n=0; n<nodes_.size(); ++n)
+    {
+        nodes_[n]->xbarOld = nodes_[n]->xbar;
+        CoinFillN(&nodes_[n]->xbar[0],static_cast<int>(nodes_[n]->xbar.size()),0.0);
+        CoinFillN(&nodes_[n]->spread[0],static_cast<int>(nodes_[n]->spread.size()),0.0);
+    }
+
+    // in scenario order, so the sums do not depend on the threads
+    for (int is=0; is<nscen; ++is)
+    {
+        SmiPHScenario *sc = scenarios_[is];
+        for (int j=0; j<nNonant_; ++j)
+        {
+            int t = core_->getColStage(j);
+            nodes_[sc->node[t]]->xbar[j-core_->getColStart(t)] += sc->prob*sc->x[j];
+        }
+    }
+    change = 0.0;
+    for (unsigned int n=0; n<nodes_.size(); ++n)
+    {
+        SmiPHNode *nd = nodes_[n];
+        for (unsigned int j=0; j<nd->xbar.size(); ++j)
+        {
+            nd->xbar[j] /= nd->prob;
+            change += nd->prob*fabs(nd->xbar[j]-nd->xbarOld[j]);
+        }
+    }
+
+    double conv = 0.0;
+    for (int is=0; is<nscen; ++is)
+    {
+        SmiPHScenario *sc = scenarios_[is];
+        for (int j=0; j<nNonant_; ++j)
+        {
+            int t = core_->getColStage(j);
+            int jt = j-core_->getColStart(t);
+            SmiPHNode *nd = nodes_[sc->node[t]];
+            double d = fabs(sc->x[j]-nd->xbar[jt]);
+            nd->spread[jt] = CoinMax(nd->spread[jt],d);
+            conv += sc->prob*d;
+        }
+    }
+    return conv;
+}
+
+double
+SmiProgressiveHedgingSolver::expectedValue()
+{
+    double z = 0.0;
+    for (unsigned int is=0; is<scenarios_.size(); ++is)
+        z += scenarios_[is]->prob*scenarios_[is]->value;
+    return z;
+}
+
+int
+SmiProgressiveHedgingSolver::evaluateBounds(SmiPHReport &rep)
+{
+    // the multipliers sum to zero over every node, so this is a relaxation
+    if (solveScenarios(LagrangianSolve,false) < 0)
+        return -1;
+    rep.lowerBound = expectedValue();
+    lowerBound_ = CoinMax(lowerBound_,rep.lowerBound);
+
+    // an infeasible scenario only means there is no upper bound
+    if (!solveScenarios(FixedSolve,false))
+    {
+        rep.upperBound = expectedValue();
+        upperBound_ = CoinMin(upperBound_,rep.upperBound);
+    }
+    return 0;
+}
+
+int
+SmiProgressiveHedgingSolver::solve()
+{
+    double inf = osi_->getInfinity();
+    buildScenarios();
+    lowerBound_ = -inf;
+    upperBound_ = inf;
+    numIter_ = 0;
+    report_.clear();
+    int nscen = static_cast<int>(scenarios_.size());
+
+    // iteration 0: the scenario problems as they are, the Wait-and-See bound
+    if (solveScenarios(LagrangianSolve,true) < 0)
+        return -1;
+    SmiPHReport rep;
+    rep.iteration = 0;
+    rep.rho = rho_;
+    rep.lowerBound = expectedValue();
+    rep.upperBound = inf;
+    lowerBound_ = rep.lowerBound;
+
+    int rc = 1;
+    bool bounded = false;
+    for (;;)
+    {
+        double change;
+        convergence_ = updateAverages(change);
+        rep.convergence = convergence_;
+
+        // w += rho (x - xbar)
+        for (int is=0; is<nscen; ++is)
+        {
+            SmiPHScenario *sc = scenarios_[is];
+            for (int j=0; j<nNonant_; ++j)
+            {
+                int t = core_->getColStage(j);
+                sc->w[j] += rho_*(sc->x[j]-nodes_[sc->node[t]]->xbar[j-core_->getColStart(t)]);
+            }
+        }
+
+        if (convergence_ <= convTol_)
+            rc = 0;
+        bounded = false;
+        if (numIter_ && (rc == 0 || numIter_ == maxIter_ || (boundFreq_ > 0 && numIter_%boundFreq_ == 0)))
+        {
+            if (evaluateBounds(rep) < 0)
+                rc = -1;
+            bounded = true;
+        }
+        report_.push_back(rep);
+        if (rc != 1 || numIter_ >= maxIter_)
+            break;
+
+        // residual balancing: distance from the averages against their change
+        if (adaptiveRho_ && numIter_)
+        {
+            if (convergence_ > 10.0*rho_*change)
+                rho_ *= 2.0;
+            else if (rho_*change > 10.0*convergence_)
+                rho_ *= 0.5;
+        }
+
+        numIter_++;
+        rep.iteration = numIter_;
+        rep.rho = rho_;
+        rep.lowerBound = -inf;
+        rep.upperBound = inf;
+        if (solveScenarios(PenaltySolve,true) < 0)
+        {
+            rc = -1;
+            break;
+        }
+    }
+
+    // bounds for the last iterate
+    if (rc != -1 && !bounded)
+    {
+        if (evaluateBounds(report_.back()) < 0)
+            rc = -1;
+    }
+    return rc;
+}
@@ -0,0 +1,193 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#ifndef SmiProgressiveHedgingSolver_HPP
+#define SmiProgressiveHedgingSolver_HPP
+
+#include "CoinPragma.hpp"
+#include "OsiSolverInterface.hpp"
+#include "SmiScnModel.hpp"
+#include "SmiScenarioWorkerPool.hpp"
+
+#include <vector>
+
+class SmiPHScenario;
+class SmiPHNode;
+class SmiPHWork;
+class SmiPHSolve;
+
+/// one line of the Progressive Hedging iteration report
+class SmiPHReport
+{
+public:
+    int iteration;
+    /// probability weighted distance of the scenario solutions from the node averages
+    double convergence;
+    /// penalty parameter used in the iteration
+    double rho;
+    /// bounds evaluated in the iteration; -infinity and infinity if none
+    double lowerBound;
+    double upperBound;
+};
+
+//#############################################################################
+
+/** SmiProgressiveHedgingSolver: scenario decomposition of stochastic (MI)LPs
+
+Every scenario problem is solved on its own, with the objective
+augmented by w x + rho/2 |x - xbar|^2, where xbar are the averages of
+the scenario solutions over the tree nodes the scenario passes through
+(the nonanticipativity structure of the tree) and w are the multipliers
+of the nonanticipativity constraints. Columns of the last stage are not
+constrained.
+
+The solver only uses OsiSolverInterface, so the quadratic term is made
+linear. For binary columns it is exact: x^2 = x. For other columns it is
+a penalty column p >= 0 with cost rho/2 and tangent rows of (x - xbar)^2
+at xbar +/- k h, k = 1,...,getNumPenaltyPieces(), h the largest distance
+of a scenario solution from xbar. Integer columns stay integer;
+scenario problems with integer columns are solved with branchAndBound.
+
+Scenarios are solved by getNumThreads() workers of a
+SmiScenarioWorkerPool. A worker loads the scenario problem from
+SmiScnModel::fillScenarioArrays into its own solver for every solve, so
+only one problem per worker is in memory; a scenario keeps its iterate,
+its multipliers and, for LPs, the basis of its last iterate, which the
+next solve starts from. The averages and the report are computed in
+scenario order and do not depend on the number of threads.
+
+With setAdaptiveRho(true) rho is doubled when the distance from the
+averages is more than 10 times the change of the averages (times rho),
+and halved in the opposite case.
+
+Bounds: the lower bound is the Lagrangian bound of the current w (the
+Wait-and-See value at iteration 0), the upper bound the expected cost of
+fixing every constrained column to its node average, rounded for
+integer columns. Both are evaluated every getBoundFrequency() iterations
+and when solve returns.
+
+Typical driver fragment looks like this
+\code
+SmiScnModel smi;
+smi.readSmps("app0110");
+OsiClpSolverInterface clp;
+SmiProgressiveHedgingSolver ph(&smi,&clp);
+ph.setAdaptiveRho(true);
+ph.solve();
+printf("%g <= z <= %g\n",ph.getLowerBound(),ph.getUpperBound());
+\endcode
+*/
+class SmiProgressiveHedgingSolver
+{
+public:
+
+    /**@name Constructor and destructor
+
+    osi is cloned once per worker.
+    */
+    //@{
+    SmiProgressiveHedgingSolver(SmiScnModel *smi, OsiSolverInterface *osi);
+    ~SmiProgressiveHedgingSolver();
+    //@}
+
+    /**@name Parameters */
+    //@{
+    /// penalty parameter (default 1)
+    void setRho(double rho) { rho_ = rho; }
+    double getRho() { return rho_; }
+    /// residual balancing of rho (default false)
+    void setAdaptiveRho(bool b) { adaptiveRho_ = b; }
+    bool getAdaptiveRho() { return adaptiveRho_; }
+    /// maximum number of iterations (default 100)
+    void setMaxIterations(int n) { maxIter_ = n; }
+    int getMaxIterations() { return maxIter_; }
+    /// convergence value at which solve stops (default 1e-4)
+    void setConvergenceTolerance(double tol) { convTol_ = tol; }
+    double getConvergenceTolerance() { return convTol_; }
+    /// bounds every n iterations; 0 (default) only at iteration 0 and at the end
+    void setBoundFrequency(int n) { boundFreq_ = n; }
+    int getBoundFrequency() { return boundFreq_; }
+    /// tangents on each side of xbar for non-binary columns (default 4)
+    void setNumPenaltyPieces(int n) { numPieces_ = n; }
+    int getNumPenaltyPieces() { return numPieces_; }
+    /// number of threads solving scenarios (default SmiScnModel::getNumThreads())
+    void setNumThreads(int n) { numThreads_ = n; }
+    int getNumThreads() { return numThreads_; }
+    //@}
+
+    /**@name Solve
+
+    Returns 0 when the convergence value is below the tolerance, 1 when
+    the iteration limit is reached and -1 when a scenario problem cannot
+    be solved.
+    */
+    //@{
+    int solve();
+    //@}
+
+    /**@name Results */
+    //@{
+    /// best upper bound found
+    double getObjValue() { return upperBound_; }
+    double getLowerBound() { return lowerBound_; }
+    double getUpperBound() { return upperBound_; }
+    double getConvergence() { return convergence_; }
+    int getNumIterations() { return numIter_; }
+    /// stage 0 node average, in core column order
+    const double *getColSolution();
+    /// last solution of scenario is, in core column order
+    const double *getScenarioSolution(int is);
+    /// one line per iteration, iteration 0 first
+    const std::vector<SmiPHReport> &getReport() { return report_; }
+    //@}
+
+private:
+    friend class SmiPHSolve;
+    enum SolveMode { PenaltySolve, LagrangianSolve, FixedSolve };
+
+    /// builds the workers, the scenarios and the node structure
+    void buildScenarios();
+    /** Solves every scenario problem in the given form; returns -1 if one
+        fails. With iterate the solutions become the current iterates. */
+    int solveScenarios(SolveMode mode, bool iterate);
+    /// loads the problem of scenario is in the given form into osi and solves it
+    int solveScenario(OsiSolverInterface *osi, SmiPHWork &wk, int is, SolveMode mode, bool iterate);
+    /** Recomputes the node averages and the largest distances from them.
+        Returns the convergence value; change is the weighted change of the averages. */
+    double updateAverages(double &change);
+    /// probability weighted value of the last scenario solves
+    double expectedValue();
+    /// Lagrangian and fixed-average bounds; entered into rep
+    int evaluateBounds(SmiPHReport &rep);
+
+private:
+    SmiScnModel *smi_;
+    SmiCoreData *core_;
+    OsiSolverInterface *osi_;
+
+    std::vector<SmiPHScenario *> scenarios_;
+    std::vector<SmiPHNode *> nodes_;
+    SmiScenarioWorkerPool *pool_;
+    std::vector<SmiPHWork *> work_;
+    // integer columns, in core positions
+    std::vector<int> intCols_;
+    std::vector<bool> isInt_;
+    // columns with nonanticipativity constraints: those before the last stage
+    int nNonant_;
+
+    double rho_;
+    bool adaptiveRho_;
+    int maxIter_;
+    double convTol_;
+    int boundFreq_;
+    int numPieces_;
+    int numThreads_;
+
+    double lowerBound_;
+    double upperBound_;
+    double convergence_;
+    int numIter_;
+    std::vector<SmiPHReport> report_;
+};
+
+#endif //SmiProgressiveHedgingSolver_HPP
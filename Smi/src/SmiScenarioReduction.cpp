@@ -0,0 +1,232 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#include "SmiScenarioReduction.hpp"
+#include "CoinFinite.hpp"
+
+#include <cmath>
+#include <cassert>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+double
+SmiScenarioL1Distance::distance(int i, int j)
+{
+    const double *xi = x_ + static_cast<size_t>(i)*dim_;
+    const double *xj = x_ + static_cast<size_t>(j)*dim_;
+    // independent partial sums, so the loop maps onto vector lanes
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    int k = 0;
+    for (; k+4<=dim_; k+=4)
+    {
+        s0 += fabs(xi[k]-xj[k]);
+        s1 += fabs(xi[k+1]-xj[k+1]);
+        s2 += fabs(xi[k+2]-xj[k+2]);
+        s3 += fabs(xi[k+3]-xj[k+3]);
+    }
+    for (; k<dim_; ++k)
+        s0 += fabs(xi[k]-xj[k]);
+    return (s0+s1) + (s2+s3);
+}
+
+//#############################################################################
+
+SmiScenarioReduction::SmiScenarioReduction(int n, const double *prob, SmiScenarioDistance *dist, int numThreads) :
+    n_(n), prob_(prob), dist_(dist), numThreads_(numThreads), distance_(0.0)
+{
+    assert(n > 0);
+}
+
+double
+SmiScenarioReduction::reduce(Method method, int numScenarios, double tolerance)
+{
+    if (numScenarios < 1)
+        numScenarios = 1;
+    if (method == ForwardSelection)
+        forwardSelection(numScenarios,tolerance);
+    else
+        backwardReduction(numScenarios,tolerance);
+    return distance_;
+}
+
+void
+SmiScenarioReduction::forwardSelection(int numScenarios, double tolerance)
+{
+    vector<bool> isKept(n_,false);
+    // distance of every scenario to the nearest selected one
+    vector<double> minDist(n_,COIN_DBL_MAX);
+    vector<double> z(n_);
+    int nkept = 0;
+    double dist = COIN_DBL_MAX;
+    while (nkept < n_ && (nkept < numScenarios || dist > tolerance))
+    {
+        // distance of the selection with u added, for every candidate u;
+        // a worker evaluates the distance row of one candidate at a time
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic,16) if(numThreads_ > 1)
+#endif
+        for (int u=0; u<n_; ++u)
+        {
+            if (isKept[u])
+                continue;
+            double s = 0.0;
+            for (int k=0; k<n_; ++k)
+            {
+                if (isKept[k] || k == u)
+                    continue;
+                double cku = c(k,u);
+                s += prob_[k] * (cku < minDist[k] ? cku : minDist[k]);
+            }
+            z[u] = s;
+        }
+
+        // first best candidate, as on one thread
+        int best = -1;
+        for (int u=0; u<n_; ++u)
+            if (!isKept[u] && (best < 0 || z[u] < z[best]))
+                best = u;
+        isKept[best] = true;
+        ++nkept;
+        dist = z[best];
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic,64) if(numThreads_ > 1)
+#endif
+        for (int k=0; k<n_; ++k)
+        {
+            double ckb = c(k,best);
+            if (ckb < minDist[k])
+                minDist[k] = ckb;
+        }
+    }
+    redistribute(isKept);
+}
+
+void
+SmiScenarioReduction::backwardReduction(int numScenarios, double tolerance)
+{
+    vector<bool> isKept(n_,true);
+    vector<int> a(n_), b(n_);
+    vector<double> ca(n_), cb(n_);
+    vector<int> update(n_);
+    for (int k=0; k<n_; ++k)
+        update[k] = k;
+    nearestKept(update,isKept,a,b,ca,cb);
+
+    vector<double> delta(n_);
+    int nkept = n_;
+    double dist = 0.0;
+    while (nkept > numScenarios)
+    {
+        // increase of the distance when l is removed: l goes to its
+        // nearest kept scenario, the scenarios mapped to l to their second nearest
+        for (int l=0; l<n_; ++l)
+            if (isKept[l])
+                delta[l] = prob_[l] * ca[l];
+        for (int k=0; k<n_; ++k)
+            if (!isKept[k])
+                delta[a[k]] += prob_[k] * (cb[k] - ca[k]);
+
+        int best = -1;
+        for (int l=0; l<n_; ++l)
+            if (isKept[l] && (best < 0 || delta[l] < delta[best]))
+                best = l;
+        if (dist + delta[best] > tolerance)
+            break;
+
+        isKept[best] = false;
+        --nkept;
+        dist += delta[best];
+        update.clear();
+        for (int k=0; k<n_; ++k)
+            if (a[k] == best || b[k] == best)
+                update.push_back(k);
+        nearestKept(update,isKept,a,b,ca,cb);
+    }
+    redistribute(isKept);
+}
+
+void
+SmiScenarioReduction::nearestKept(const vector<int> &list, const vector<bool> &isKept,
+    vector<int> &a, vector<int> &b, vector<double> &ca, vector<double> &cb)
+{
+    int nlist = static_cast<int>(list.size());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic,16) if(numThreads_ > 1)
+#endif
+    for (int i=0; i<nlist; ++i)
+    {
+        int k = list[i];
+        int ak = -1, bk = -1;
+        double cak = COIN_DBL_MAX, cbk = COIN_DBL_MAX;
+        for (int j=0; j<n_; ++j)
+        {
+            if (j == k || !isKept[j])
+                continue;
+            double ckj = c(k,j);
+            if (ak < 0 || ckj < cak)
+            {
+                bk = ak;
+                cbk = cak;
+                ak = j;
+                cak = ckj;
+            }
+            else if (bk < 0 || ckj < cbk)
+            {
+                bk = j;
+                cbk = ckj;
+            }
+        }
+        a[k] = ak;
+        b[k] = bk;
+        ca[k] = cak;
+        cb[k] = cbk;
+    }
+}
+
+void
+SmiScenarioReduction::redistribute(const vector<bool> &isKept)
+{
+    kept_.clear();
+    for (int k=0; k<n_; ++k)
+        if (isKept[k])
+            kept_.push_back(k);
+    assert(!kept_.empty());
+
+    // nearest kept scenario of every removed one
+    int nkept = static_cast<int>(kept_.size());
+    vector<double> ck(n_,0.0);
+    target_.assign(n_,-1);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic,16) if(numThreads_ > 1)
+#endif
+    for (int k=0; k<n_; ++k)
+    {
+        int s = k;
+        if (!isKept[k])
+        {
+            s = kept_[0];
+            ck[k] = c(k,s);
+            for (int i=1; i<nkept; ++i)
+            {
+                double cki = c(k,kept_[i]);
+                if (cki < ck[k])
+                {
+                    s = kept_[i];
+                    ck[k] = cki;
+                }
+            }
+        }
+        target_[k] = s;
+    }
+
+    newProb_.assign(n_,0.0);
+    distance_ = 0.0;
+    for (int k=0; k<n_; ++k)
+    {
+        distance_ += prob_[k] * ck[k];
+        newProb_[target_[k]] += prob_[k];
+    }
+}
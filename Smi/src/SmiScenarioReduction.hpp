@@ -0,0 +1,133 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#ifndef SmiScenarioReduction_HPP
+#define SmiScenarioReduction_HPP
+
+#include "CoinPragma.hpp"
+
+#include <vector>
+#include <cstddef>
+
+//#############################################################################
+
+/** SmiScenarioDistance: distances between scenarios
+
+The reduction asks for distances as it needs them and keeps none of
+them, so a distance may be computed more than once. distance(i,j) must
+be symmetric, 0 for i == j, and safe to call from several threads at
+once.
+*/
+class SmiScenarioDistance
+{
+public:
+    virtual ~SmiScenarioDistance() {}
+    virtual double distance(int i, int j) = 0;
+};
+
+/** l1 distances between the rows of x (one row of dim entries per
+scenario); x must live as long as the object. */
+class SmiScenarioL1Distance : public SmiScenarioDistance
+{
+public:
+    SmiScenarioL1Distance(int dim, const double *x) : dim_(dim), x_(x) {}
+    virtual double distance(int i, int j);
+
+private:
+    int dim_;
+    const double *x_;
+};
+
+//#############################################################################
+
+/** SmiScenarioReduction: Kantorovich distance scenario reduction
+
+Given n scenarios with probabilities p and distances c between them,
+selects a subset S of the scenarios so that the Kantorovich distance of
+the reduced distribution, sum over k not in S of p_k min_{s in S} c(k,s),
+is small. The probability of every removed scenario is redistributed to
+the kept scenario nearest to it, which is optimal for the chosen subset.
+
+No distance matrix is stored: memory is O(n) per worker. Distances are
+evaluated on demand, a row of scenarios per worker at a time.
+
+Two heuristics of Heitsch and Roemisch are implemented:
+ - ForwardSelection: starts from the empty set and adds the scenario
+   that lowers the distance most. Every step evaluates the distance row
+   of every candidate, O(n^2) distances, so it suits reductions to few
+   scenarios.
+ - BackwardReduction: starts from all scenarios and removes the one that
+   raises the distance least. Keeps the nearest and second nearest kept
+   scenario of every scenario, found with n^2 distances at the start; a
+   step costs O(n) plus a rescan of the kept scenarios for every scenario
+   whose neighbours were removed, so it suits mild reductions.
+
+The result does not depend on the number of threads.
+
+Typical driver fragment looks like this
+\code
+SmiScenarioL1Distance dist(dim,x);
+SmiScenarioReduction red(n,prob,&dist,4);
+double d = red.reduce(SmiScenarioReduction::ForwardSelection,10,COIN_DBL_MAX);
+\endcode
+*/
+class SmiScenarioReduction
+{
+public:
+
+    /// reduction heuristics
+    enum Method { ForwardSelection, BackwardReduction };
+
+    /**@name Constructor and destructor
+
+    prob holds n probabilities; prob and dist must live as long as the
+    object. Distances are evaluated on up to numThreads threads.
+    */
+    //@{
+    SmiScenarioReduction(int n, const double *prob, SmiScenarioDistance *dist, int numThreads=1);
+    ~SmiScenarioReduction() {}
+    //@}
+
+    /** Keeps numScenarios scenarios (at least one), and as many more as
+    the heuristic needs to bring the distance within tolerance: with
+    tolerance COIN_DBL_MAX exactly numScenarios are kept, with
+    numScenarios 1 the reduction only stops at the tolerance. Returns
+    the Kantorovich distance of the reduced distribution. */
+    double reduce(Method method, int numScenarios, double tolerance);
+
+    /**@name Results */
+    //@{
+    int getNumKept() { return static_cast<int>(kept_.size()); }
+    /// kept scenarios, in increasing order
+    const std::vector<int> &getKept() { return kept_; }
+    /// kept scenario that scenario i is mapped to
+    int getTarget(int i) { return target_[i]; }
+    /// probabilities after redistribution, 0 for removed scenarios
+    const std::vector<double> &getProbabilities() { return newProb_; }
+    double getDistance() { return distance_; }
+    //@}
+
+private:
+    double c(int i, int j) { return dist_->distance(i,j); }
+    void forwardSelection(int numScenarios, double tolerance);
+    void backwardReduction(int numScenarios, double tolerance);
+    /// nearest (a, at distance ca) and second nearest (b, cb) kept scenario
+    /// other than k, for every k in list
+    void nearestKept(const std::vector<int> &list, const std::vector<bool> &isKept,
+        std::vector<int> &a, std::vector<int> &b, std::vector<double> &ca, std::vector<double> &cb);
+    /// fills kept_, target_ and newProb_ from isKept
+    void redistribute(const std::vector<bool> &isKept);
+
+private:
+    int n_;
+    const double *prob_;
+    SmiScenarioDistance *dist_;
+    int numThreads_;
+
+    std::vector<int> kept_;
+    std::vector<int> target_;
+    std::vector<double> newProb_;
+    double distance_;
+};
+
+#endif //SmiScenarioReduction_HPP
@@ -10,93 +10,79 @@
  */
 
 #include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstddef>
 #include <map>
 #include <iostream>
 #include <cassert>
+#include <new>
 
 #include "CoinPragma.hpp"
 
+template<class T> class SmiTreeArena;
+
 /** SmiTreeNode template class.
 
- Manages pointers to parent, child and sibling for tree navigation.
- Template class instance is a pointer to an object that
- must be created with "new" operator.
+ Handle to a node of a tree held in an SmiTreeArena; the links are
+ looked up in the arena. Template class instance is a pointer to an
+ object that must be created with "new" operator.
+
+ A node created with a constructor is the root of a new tree and owns
+ its arena; nodes created with addChild belong to the arena and must not
+ be deleted.
  */
 
 template<class T>
 class SmiTreeNode {
 	//friend void SmiTreeNodeUnitTest();
+	friend class SmiTreeArena<T>;
 public:
 
-	typedef std::map<int, SmiTreeNode<T>*> child_label_map;
-
 	bool hasParent() {
-		return (parent_ != NULL);
+		return (arena_->parent(index_) >= 0);
 	}
 	bool hasChild() {
-		return (child_ != NULL);
+		return (arena_->child(index_) >= 0);
 	}
 	bool hasSibling() {
-		return (sibling_ != NULL);
+		return (arena_->sibling(index_) >= 0);
 	}
 
 	SmiTreeNode<T> *getParent() {
-		return parent_;
+		return arena_->node(arena_->parent(index_));
 	}
 	SmiTreeNode<T> *getChild() {
-		return child_;
+		return arena_->node(arena_->child(index_));
 	}
 	SmiTreeNode<T> *getSibling() {
-		return sibling_;
+		return arena_->node(arena_->sibling(index_));
 	}
 
 	void setLastChildLabel(int label) {
-		child_labels_.insert(std::make_pair(label, this->getChild()));
+		arena_->setChildLabel(index_, label, arena_->child(index_));
 	}
 
 	SmiTreeNode<T> *getChildByLabel(int n) {
-
-		/*
-		 //AJK debug code
-		 child_label_map::iterator begpos = child_labels_.begin();
-		 child_label_map::iterator endpos = child_labels_.end();
-		 while(begpos!=endpos)
-		 {
-		 printf(" found label %d \n",begpos->first);
-		 ++begpos;
-		 }
-		 */
-		typename child_label_map::iterator pos = child_labels_.find(n);
-		if (pos != child_labels_.end())
-			return pos->second;
-		else
-			return NULL;
+		return arena_->node(arena_->childByLabel(index_, n));
 	}
 
 	int depth() {
-		return depth_;
+		return arena_->depth(index_);
 	}
 	int numChildren() {
-		return nchild_;
+		return arena_->numChildren(index_);
 	}
 	int scenario() {
-		return scen_;
+		return arena_->scenario(index_);
 	}
 	void setScenario(int s) {
-		scen_ = s;
+		arena_->setScenario(index_, s);
 	}
-	
+
 	// Returns new child node with cd, linked in the tree
 	SmiTreeNode<T> * addChild(T cd, int scenario) {
-		SmiTreeNode<T> *c = new SmiTreeNode(cd);
-
-		c->parent_ = this;
-		c->depth_ = depth_ + 1;
-		c->sibling_ = child_;
-		c->scen_ = scenario;
-		nchild_++;
-		child_ = c;
-		return c;
+		return arena_->node(arena_->addNode(cd, index_, scenario));
 	}
 
 	std::vector<SmiTreeNode<T> *> *getChildren() {
@@ -113,38 +99,36 @@ public:
 	}
 
 	T getDataPtr() {
-		return ptr_;
+		return arena_->data(index_);
+	}
+
+	/// position of the node in its arena
+	int index() {
+		return index_;
 	}
 
 	//--------------------------------------------------------------------------
 	/**@name Constructors, destructors and major modifying methods*/
 	//@{
 	/// Default Constructor creates an empty node
-	SmiTreeNode<T> () {
-		parent_ = NULL;
-		child_ = NULL;
-		sibling_ = NULL;
-		nchild_ = 0;
-		depth_ = 0;
-		scen_ = -1;
+	SmiTreeNode<T> () :
+		arena_(new SmiTreeArena<T>(this)), index_(0), owner_(true) {
+		arena_->addNode(T(), -1, -1);
 	}
 
 	/// Constructor from P
-	SmiTreeNode<T> (T p) {
-		parent_ = NULL;
-		child_ = NULL;
-		sibling_ = NULL;
-		nchild_ = 0;
-		depth_ = 0;
-		ptr_ = p;
-		scen_ = -1;
+	SmiTreeNode<T> (T p) :
+		arena_(new SmiTreeArena<T>(this)), index_(0), owner_(true) {
+		arena_->addNode(p, -1, -1);
 	}
 
-	/// Destructor
-
+	/** Destructor: the root of a tree releases the whole arena.
+	 No recursion: the cost is linear in the number of nodes whatever
+	 the shape of the tree, so a root with millions of children or a
+	 very deep path is safe to delete. */
 	~SmiTreeNode<T>() {
-		delete sibling_;
-		delete child_;
+		if (owner_)
+			delete arena_;
 	}
 
 	//@}
@@ -152,31 +136,256 @@ public:
 protected:
 
 	void setChild(SmiTreeNode<T> *c) {
-		child_ = c;
+		arena_->setChild(index_, c ? c->index_ : -1);
 	}
 	void setSibling(SmiTreeNode<T> *s) {
-		sibling_ = s;
+		arena_->setSibling(index_, s ? s->index_ : -1);
 	}
 	SmiTreeNode<T> *getParentP() {
-		return parent_;
+		return getParent();
 	}
 	SmiTreeNode<T> *getChildP() {
-		return child_;
+		return getChild();
 	}
 	SmiTreeNode<T> *getSiblingP() {
-		return sibling_;
+		return getSibling();
 	}
 
 private:
-	SmiTreeNode<T> *parent_;
-	SmiTreeNode<T> *child_;
-	SmiTreeNode<T> *sibling_;
-	int scen_;
-	int nchild_;
-	int depth_;
-	T ptr_;
-	child_label_map child_labels_;
+	/// handle of node i of arena a
+	SmiTreeNode<T> (SmiTreeArena<T> *a, int i) :
+		arena_(a), index_(i), owner_(false) {
+	}
+
+	SmiTreeArena<T> *arena_;
+	int index_;
+	bool owner_;
+
+};
+
+/** SmiTreeArena template class.
+
+ Contiguous storage of a tree. Node i has its parent, first child, next
+ sibling, depth, scenario and child count at position i of parallel
+ arrays; links are indices, -1 for none. Nodes are numbered in the order
+ they are added, the root is node 0, and new children are linked in
+ front of their siblings.
+
+ The SmiTreeNode handles are allocated in blocks of fixed size, so their
+ addresses stay valid as the tree grows. All nodes are released together
+ when the arena is destroyed, block by block; nothing follows the links.
+
+ Child labels of all nodes are kept in one open addressing hash table
+ keyed by (parent, label), with linear probing and at most half full.
+ */
+template<class T>
+class SmiTreeArena {
+public:
+
+	enum { BlockShift = 10, BlockSize = 1 << BlockShift };
+
+	/**@name Links of node i */
+	//@{
+	int parent(int i) const {
+		return parent_[i];
+	}
+	int child(int i) const {
+		return child_[i];
+	}
+	int sibling(int i) const {
+		return sibling_[i];
+	}
+	int depth(int i) const {
+		return depth_[i];
+	}
+	int numChildren(int i) const {
+		return nchild_[i];
+	}
+	int scenario(int i) const {
+		return scen_[i];
+	}
+	void setScenario(int i, int s) {
+		scen_[i] = s;
+	}
+	void setChild(int i, int c) {
+		child_[i] = c;
+	}
+	void setSibling(int i, int s) {
+		sibling_[i] = s;
+	}
+	T data(int i) const {
+		return data_[i];
+	}
+	//@}
+
+	/**@name Child labels */
+	//@{
+	/// labels child of parent; an existing label of parent is kept
+	void setChildLabel(int parent, int label, int child) {
+		if (2 * (labelCount_ + 1) > static_cast<int>(labelParent_.size()))
+			growLabels();
+		int mask = static_cast<int>(labelParent_.size()) - 1;
+		int h = hashLabel(parent, label) & mask;
+		while (labelParent_[h] >= 0) {
+			if (labelParent_[h] == parent && labelKey_[h] == label)
+				return;
+			h = (h + 1) & mask;
+		}
+		labelParent_[h] = parent;
+		labelKey_[h] = label;
+		labelChild_[h] = child;
+		labelCount_++;
+	}
+
+	/// child of parent with the given label, -1 if none
+	int childByLabel(int parent, int label) const {
+		if (labelCount_ == 0)
+			return -1;
+		int mask = static_cast<int>(labelParent_.size()) - 1;
+		int h = hashLabel(parent, label) & mask;
+		while (labelParent_[h] >= 0) {
+			if (labelParent_[h] == parent && labelKey_[h] == label)
+				return labelChild_[h];
+			h = (h + 1) & mask;
+		}
+		return -1;
+	}
+	//@}
+
+	/// number of nodes
+	int size() const {
+		return static_cast<int>(data_.size());
+	}
 
+	/// node data in the order the nodes were added
+	std::vector<T> &nodeData() {
+		return data_;
+	}
+
+	/// handle of node i; NULL for -1
+	SmiTreeNode<T> *node(int i) {
+		if (i < 0)
+			return NULL;
+		if (i == 0 && root_)
+			return root_;
+		return &blocks_[i >> BlockShift][i & (BlockSize - 1)];
+	}
+
+	/** Adds a node as the first child of parent, or as the root
+	 if parent is -1. Returns its index. */
+	int addNode(T p, int parent, int scenario) {
+		int i = size();
+		data_.push_back(p);
+		parent_.push_back(parent);
+		child_.push_back(-1);
+		sibling_.push_back(-1);
+		nchild_.push_back(0);
+		scen_.push_back(scenario);
+		if (parent >= 0) {
+			depth_.push_back(depth_[parent] + 1);
+			sibling_[i] = child_[parent];
+			child_[parent] = i;
+			nchild_[parent]++;
+		} else {
+			assert(i == 0);
+			depth_.push_back(0);
+		}
+		if ((i & (BlockSize - 1)) == 0)
+			blocks_.push_back(static_cast<SmiTreeNode<T> *> (::operator new(
+					BlockSize * sizeof(SmiTreeNode<T>))));
+		new (blocks_.back() + (i & (BlockSize - 1))) SmiTreeNode<T> (this, i);
+		return i;
+	}
+
+	/** Exchanges the nodes of two arenas; handles stay at their
+	 addresses and move with their nodes. Not for arenas of a root
+	 created with a constructor. */
+	void swap(SmiTreeArena<T> &o) {
+		assert(!root_ && !o.root_);
+		parent_.swap(o.parent_);
+		child_.swap(o.child_);
+		sibling_.swap(o.sibling_);
+		depth_.swap(o.depth_);
+		scen_.swap(o.scen_);
+		nchild_.swap(o.nchild_);
+		data_.swap(o.data_);
+		labelParent_.swap(o.labelParent_);
+		labelKey_.swap(o.labelKey_);
+		labelChild_.swap(o.labelChild_);
+		std::swap(labelCount_, o.labelCount_);
+		blocks_.swap(o.blocks_);
+		setHandles();
+		o.setHandles();
+	}
+
+	/** Default Constructor creates an empty tree.
+	 root is the handle of node 0 if it lives outside the arena. */
+	SmiTreeArena<T> (SmiTreeNode<T> *root = NULL) :
+		labelCount_(0), root_(root) {
+	}
+
+	/// Destructor releases the handles, block by block
+	~SmiTreeArena<T>() {
+		int n = size();
+		for (unsigned int b = 0; b < blocks_.size(); ++b) {
+			int used = std::min<int>(BlockSize, n - b * BlockSize);
+			for (int i = 0; i < used; ++i)
+				blocks_[b][i].~SmiTreeNode<T>();
+			::operator delete(blocks_[b]);
+		}
+	}
+
+private:
+	static int hashLabel(int parent, int label) {
+		unsigned int h = static_cast<unsigned int>(parent) * 0x9E3779B1u
+				^ static_cast<unsigned int>(label) * 0x85EBCA77u;
+		h ^= h >> 15;
+		return static_cast<int>(h & 0x7fffffff);
+	}
+
+	/// handles are never copied
+	SmiTreeArena<T> (const SmiTreeArena<T> &);
+	SmiTreeArena<T> &operator=(const SmiTreeArena<T> &);
+
+	/// points the handles at this arena
+	void setHandles() {
+		int n = size();
+		for (int i = 0; i < n; ++i)
+			blocks_[i >> BlockShift][i & (BlockSize - 1)].arena_ = this;
+	}
+
+	/// doubles the label table and reinserts the labels
+	void growLabels() {
+		std::vector<int> oldParent, oldKey, oldChild;
+		oldParent.swap(labelParent_);
+		oldKey.swap(labelKey_);
+		oldChild.swap(labelChild_);
+		int n = oldParent.empty() ? 16 : 2 * static_cast<int>(oldParent.size());
+		labelParent_.assign(n, -1);
+		labelKey_.resize(n);
+		labelChild_.resize(n);
+		labelCount_ = 0;
+		for (unsigned int i = 0; i < oldParent.size(); ++i)
+			if (oldParent[i] >= 0)
+				setChildLabel(oldParent[i], oldKey[i], oldChild[i]);
+	}
+
+	std::vector<int> parent_;
+	std::vector<int> child_;
+	std::vector<int> sibling_;
+	std::vector<int> depth_;
+	std::vector<int> scen_;
+	std::vector<int> nchild_;
+	std::vector<T> data_;
+	// label table; labelParent_ is -1 for empty slots
+	std::vector<int> labelParent_;
+	std::vector<int> labelKey_;
+	std::vector<int> labelChild_;
+	int labelCount_;
+	// raw blocks of BlockSize handles, constructed in place and never
+	// moved, so growing blocks_ only copies the block pointers
+	std::vector<SmiTreeNode<T> *> blocks_;
+	SmiTreeNode<T> *root_;
 };
 
 //#############################################################################
@@ -187,6 +396,78 @@ private:
  compiled with debugging. */
 void SmiTreeNodeUnitTest();
 
+template<class T> class SmiScenarioTree;
+
+/** Iterator over the node data of a scenario, root to leaf.
+
+ Holds the tree, the scenario and the current node only: it does not
+ allocate and does not touch shared state, so several threads can
+ iterate over scenarios of the same tree at once. Stepping towards the
+ root follows the parent link; stepping towards the leaf looks up the
+ node in the ancestor table with SmiScenarioTree::find(scenario, stage).
+ */
+template<class T>
+class SmiScenarioPathIterator {
+public:
+	typedef std::bidirectional_iterator_tag iterator_category;
+	typedef T value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const T *pointer;
+	typedef T reference;
+
+	/// iterator at the given stage of scenario s; stage depth+1 is the end
+	SmiScenarioPathIterator<T> (SmiScenarioTree<T> *tree, int s, int stage) :
+		tree_(tree), scen_(s), stage_(stage), node_(NULL) {
+		if (stage_ <= tree_->getLeaf(scen_)->depth())
+			node_ = tree_->find(scen_, stage_);
+	}
+
+	T operator*() const {
+		return node_->getDataPtr();
+	}
+	/// tree node at the current position
+	SmiTreeNode<T> *node() const {
+		return node_;
+	}
+	int stage() const {
+		return stage_;
+	}
+
+	SmiScenarioPathIterator<T> &operator++() {
+		++stage_;
+		node_ = (stage_ <= tree_->getLeaf(scen_)->depth()) ? tree_->find(scen_, stage_) : NULL;
+		return *this;
+	}
+	SmiScenarioPathIterator<T> operator++(int) {
+		SmiScenarioPathIterator<T> tmp = *this;
+		++*this;
+		return tmp;
+	}
+	SmiScenarioPathIterator<T> &operator--() {
+		--stage_;
+		node_ = node_ ? node_->getParent() : tree_->getLeaf(scen_);
+		return *this;
+	}
+	SmiScenarioPathIterator<T> operator--(int) {
+		SmiScenarioPathIterator<T> tmp = *this;
+		--*this;
+		return tmp;
+	}
+
+	bool operator==(const SmiScenarioPathIterator<T> &o) const {
+		return stage_ == o.stage_ && scen_ == o.scen_ && tree_ == o.tree_;
+	}
+	bool operator!=(const SmiScenarioPathIterator<T> &o) const {
+		return !(*this == o);
+	}
+
+private:
+	SmiScenarioTree<T> *tree_;
+	int scen_;
+	int stage_;
+	SmiTreeNode<T> *node_;
+};
+
 /*TODO: split this class into two classes
  * 	1) SmiScenarioTree
  *  2) SmiLabelledTree
@@ -204,20 +485,28 @@ public:
 
 	/** begin */
 	typename std::vector<T>::iterator treeBegin() {
-		return node_data.begin();
+		return arena_.nodeData().begin();
 	}
 	/** end */
 	typename std::vector<T>::iterator treeEnd() {
-		return node_data.end();
+		return arena_.nodeData().end();
 	}
 	/** whole tree */
 	std::vector<T> &wholeTree() {
-		return node_data;
+		return arena_.nodeData();
+	}
+
+	/** scenario path iterators, root to leaf, without copying */
+	SmiScenarioPathIterator<T> pathBegin(int s) {
+		return SmiScenarioPathIterator<T> (this, s, 0);
+	}
+
+	SmiScenarioPathIterator<T> pathEnd(int s) {
+		return SmiScenarioPathIterator<T> (this, s, leaf_[s]->depth() + 1);
 	}
 
-	/** scenario iterators
-	 TODO: native code for these iterators that does not
-	 depend on copying. */
+	/** scenario iterators over a copy of the path, which is shared
+	 by all scenarios of the tree; see pathBegin and pathEnd. */
 	typename std::vector<T>::iterator scenBegin(int s) {
 		getScenario(s);
 		return scen_data.begin();
@@ -242,14 +531,11 @@ public:
 		return leaf_[scn];
 	}
 
-	/** Get node identified by scenario/stage.	*/
+	/** Get node identified by scenario/stage; constant time. */
 	SmiTreeNode<T> *find(unsigned int scenario, int stage) {
 		assert (scenario < leaf_.size());
-		SmiTreeNode<T> * n = leaf_[scenario];
-		assert (stage < n->depth() + 1);
-		while (stage < n->depth())
-			n = n->getParent();
-		return n;
+		assert (stage < leaf_[scenario]->depth() + 1);
+		return arena_.node(anc_[ancStart_[scenario] + stage]);
 	}
 
 	/** get number of scenarios */
@@ -330,6 +616,7 @@ public:
 
 		if (pathdata.size()) {
 			leaf_.push_back(parent);
+			addAncestors(parent);
 		}
 		return static_cast<int>(leaf_.size()) - 1;
 
@@ -364,6 +651,7 @@ public:
  
 		if (pathdata.size()) {
 			leaf_.push_back(parent);
+			addAncestors(parent);
 		}
 		return static_cast<int>(leaf_.size()) - 1;
 
@@ -376,11 +664,8 @@ public:
 			if (parent) {
 				parent = parent->addChild(*&pathdata[i], scenario);
 			} else {
-				parent = root_ = new SmiTreeNode<T> (*&pathdata[0]);
-				root_->setScenario(scenario);
+				parent = root_ = arena_.node(arena_.addNode(*&pathdata[0], -1, scenario));
 			}
-			// add data to full node_data array
-			node_data.push_back(*&pathdata[i]);
 		}
 
 		return parent;
@@ -392,17 +677,41 @@ public:
 	/// Default Constructor creates an empty scenario tree
 	SmiScenarioTree<T> () :
 		leaf_(0), root_(NULL) {
-			this->node_data.reserve(2);
 	}
 
-	/// Destructor
+	/// Exchanges the contents of two trees; node handles stay valid
+	void swap(SmiScenarioTree<T> &o) {
+		arena_.swap(o.arena_);
+		anc_.swap(o.anc_);
+		ancStart_.swap(o.ancStart_);
+		scen_data.swap(o.scen_data);
+		leaf_.swap(o.leaf_);
+		std::swap(root_, o.root_);
+	}
+
+	/// Destructor; the nodes are released with the arena
 	virtual ~SmiScenarioTree<T> () {
-		delete root_;
 	}
 	//@}
 
 private:
-	std::vector<T> node_data;
+	/// appends the row of the ancestor table for a new leaf
+	void addAncestors(SmiTreeNode<T> *leaf) {
+		if (ancStart_.empty())
+			ancStart_.push_back(0);
+		int start = ancStart_.back();
+		anc_.resize(start + leaf->depth() + 1);
+		for (SmiTreeNode<T> *n = leaf; n; n = n->getParent())
+			anc_[start + n->depth()] = n->index();
+		ancStart_.push_back(static_cast<int>(anc_.size()));
+	}
+
+private:
+	SmiTreeArena<T> arena_;
+	/** ancestor table: node of scenario s at stage t is
+	 anc_[ancStart_[s] + t]; one row per leaf, rows of any length */
+	std::vector<int> anc_;
+	std::vector<int> ancStart_;
 	std::vector<T> scen_data;
 	std::vector<SmiTreeNode<T> *> leaf_;
 	SmiTreeNode<T> *root_;
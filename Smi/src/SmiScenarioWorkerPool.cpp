@@ -0,0 +1,22 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#include "SmiScenarioWorkerPool.hpp"
+
+SmiScenarioWorkerPool::SmiScenarioWorkerPool(OsiSolverInterface *osi, int numWorkers)
+{
+#ifndef _OPENMP
+    numWorkers = 1;
+#endif
+    if (numWorkers < 1)
+        numWorkers = 1;
+    solvers_.resize(numWorkers);
+    for (int w=0; w<numWorkers; ++w)
+        solvers_[w] = osi->clone(false);
+}
+
+SmiScenarioWorkerPool::~SmiScenarioWorkerPool()
+{
+    for (unsigned int w=0; w<solvers_.size(); ++w)
+        delete solvers_[w];
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2026, International Business Machines
+// Corporation and others.  All Rights Reserved.
+
+#ifndef SmiScenarioWorkerPool_HPP
+#define SmiScenarioWorkerPool_HPP
+
+#include "CoinPragma.hpp"
+#include "OsiSolverInterface.hpp"
+
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//#############################################################################
+
+/** SmiScenarioWorkerPool: solvers for evaluating scenario subproblems
+
+Decomposition methods evaluate every scenario subproblem in every
+iteration. The pool owns one clone of the user's solver per worker; a
+worker keeps its solver for the life of the pool.
+
+run(n,f) calls f(solver,worker,i) for i=0,...,n-1. Scenarios are handed
+out one at a time: a worker that is done takes the next one, so uneven
+solve times do not leave workers idle. The order in which a worker
+gets its scenarios is not reproducible, so f should only write results
+indexed by i, and should not rely on what a previous call left in the
+solver: a warm start, for one, is kept per index i and set before the
+solve. Reducing the results in index order afterwards then gives the
+same result on any number of workers.
+
+Workers are OpenMP threads. If Smi is compiled without OpenMP
+there is one worker, running on the calling thread.
+*/
+class SmiScenarioWorkerPool
+{
+public:
+    /**@name Constructor and destructor */
+    //@{
+    SmiScenarioWorkerPool(OsiSolverInterface *osi, int numWorkers);
+    ~SmiScenarioWorkerPool();
+    //@}
+
+    /**@name Query members */
+    //@{
+    int getNumWorkers() { return static_cast<int>(solvers_.size()); }
+    OsiSolverInterface *getSolver(int worker) { return solvers_[worker]; }
+    //@}
+
+    /** Calls f(getSolver(w),w,i) for i=0,...,n-1, each i once, on worker w */
+    template <class F>
+    void run(int n, F &f)
+    {
+        int numWorkers = getNumWorkers();
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numWorkers) schedule(dynamic,1) if(numWorkers > 1)
+#endif
+        for (int i=0; i<n; ++i)
+        {
+#ifdef _OPENMP
+            int w = omp_get_thread_num();
+#else
+            int w = 0;
+#endif
+            f(solvers_[w],w,i);
+        }
+    }
+
+private:
+    std::vector<OsiSolverInterface *> solvers_;
+};
+
+#endif //SmiScenarioWorkerPool_HPP
@@ -2,8 +2,10 @@
 #include "CoinHelperFunctions.hpp"
 #include "OsiSolverInterface.hpp"
 #include "CoinPackedMatrix.hpp"
+#include "CoinSort.hpp"
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 using namespace std;
 
@@ -368,18 +370,72 @@ SmiNodeData::setCoreNode()
 	isCoreNode_=true;
 }
 
+SmiNodeDataArena::SmiNodeDataArena(size_t blockSize):
+	blocks_(),blockSize_(blockSize),top_(NULL),left_(0),numBytes_(0),refCount_(0)
+{
+}
+
+SmiNodeDataArena::~SmiNodeDataArena()
+{
+	for (unsigned int i=0; i<blocks_.size(); ++i)
+		free(blocks_[i]);
+}
+
+void *
+SmiNodeDataArena::allocate(size_t bytes)
+{
+	bytes = roundUp(bytes);
+	numBytes_ += bytes;
+
+	// large requests get a block of their own; the current block stays
+	if (bytes > blockSize_/4)
+	{
+		char *p = (char *)malloc(bytes ? bytes : 1);
+		assert(p);
+		blocks_.push_back(p);
+		return p;
+	}
+
+	if (bytes > left_)
+	{
+		top_ = (char *)malloc(blockSize_);
+		assert(top_);
+		blocks_.push_back(top_);
+		left_ = blockSize_;
+	}
+	char *p = top_;
+	top_ += bytes;
+	left_ -= bytes;
+	return p;
+}
+
+void
+SmiNodeDataArena::release(void *p, size_t bytes)
+{
+	bytes = roundUp(bytes);
+	numBytes_ -= bytes;
+
+	// the last allocation of the current block can be reused
+	if (static_cast<char *>(p) + bytes == top_ && bytes <= blockSize_ - left_)
+	{
+		top_ -= bytes;
+		left_ += bytes;
+	}
+}
+
 // constructor from LP data
 // copies present values in given data structures for an SmiNodeData
 // TODO: allow for special node data like integer variables not in core, etc
 //Christian: Stores information corresponding to given stage for ranges, objective and bounds, but not for the matrix. This needs to be done in a better way, eventually.
-//Excess memory is released at the end of the method.
+//The elements of the stage are counted first, so the arrays get their exact size.
 SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 				 const CoinPackedMatrix * const matrix,
 				 CoinPackedVector *dclo,
 				 CoinPackedVector *dcup,
 				 CoinPackedVector *dobj,
 				 CoinPackedVector *drlo,
-				 CoinPackedVector *drup):
+				 CoinPackedVector *drup,
+				 SmiNodeDataArena *arena):
 				 stg_(stg),
 				 core_(core), isCoreNode_(false),
 				 numarrays_(5), // 5 arrays: dclo, dcup, dobj, drlo, drup
@@ -387,26 +443,37 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 				 ncol_(core->getNumCols(stg_)),
 				 rowbeg_(core->getRowStart(stg_)),
 				 colbeg_(core->getColStart(stg_)),
-				 ptr_count(0)  // used for counted pointer
+				 arena_(arena),
+				 ptr_count(0),  // used for counted pointer
+				 interned_(false),internHash_(0)
 {
 	//so far no QP data
 	this->setHasQdata(false);
 	this->nqdata_=NULL;
 
-	// count an upper bound for number elements
+	has_matrix_ = (matrix && matrix->getNumElements() > 0);
+
+	// we need a row-ordered matrix here,
+	// so we might need a reversed-ordered copy of 'matrix'.
+	CoinPackedMatrix * revOrdMatrix = NULL;
+	if (has_matrix_ && matrix->isColOrdered())
+	{
+		revOrdMatrix = new CoinPackedMatrix();
+		revOrdMatrix->reverseOrderedCopyOf(*matrix);
+	}
+	// This construction is needed to honour the constness of 'matrix'
+	const CoinPackedMatrix * localMatrix
+		= (revOrdMatrix ? revOrdMatrix : matrix);
+
+	// count the elements that belong to the stage
 	nels_ = 0;
-	if (matrix)
-		nels_ += matrix->getNumElements();
-	if (dclo)
-		nels_ += dclo->getNumElements();
-	if (dcup)
-		nels_ += dcup->getNumElements();
-	if (dobj)
-		nels_ += dobj->getNumElements();
-	if (drlo)
-		nels_ += drlo->getNumElements();
-	if (drup)
-		nels_ += drup->getNumElements();
+	if (has_matrix_)
+	{
+		const int *matrix_len = localMatrix->getVectorLengths();
+		for (int i=0; i<this->nrow_; ++i)
+			nels_ += matrix_len[core->getRowExternalIndex(this->rowbeg_+i)];
+	}
+	nels_ += this->countVectorElements(dclo,dcup,dobj,drlo,drup);
 
 	// assign memory
 	this->assignMemory();
@@ -415,8 +482,6 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 	int offset_dst=0;
 	int offset_src=0;
 	int len=0;
-	int		*ind=NULL;
-	double	*els=NULL;
 	int i_start=0;
 
 	// offset_dst always points to the next free spot in SmiNodeData storage
@@ -427,22 +492,8 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 	//What is done here? CoinPackedMatrix needs to have the same size as the core Matrix, but only the current stage constraints are read in
 	//TODO: Change this behaviour, so that only a small matrix is given to this method?!?!
 	this->mat_strt_ = i_start;
-	if (matrix && matrix->getNumElements() > 0)
+	if (has_matrix_)
 	{
-		has_matrix_=true;
-
-		// we need a row-ordered matrix here,
-		// so we might need a reversed-ordered copy of 'matrix'.
-		CoinPackedMatrix * revOrdMatrix = NULL;
-		if (matrix->isColOrdered())
-		{
-			revOrdMatrix = new CoinPackedMatrix();
-			revOrdMatrix->reverseOrderedCopyOf(*matrix);
-		}
-		// This construction is needed to honour the constness of 'matrix'
-		const CoinPackedMatrix * localMatrix
-			= (matrix->isColOrdered() ? revOrdMatrix : matrix);
-
 		const double *matrix_els = localMatrix->getElements();
 		const int    *matrix_ind = localMatrix->getIndices();
 		const int    *matrix_len = localMatrix->getVectorLengths();
@@ -478,14 +529,173 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 		for (int j=0; j<offset_dst; j++)
 			this->inds_[j] = core->getColInternalIndex(this->inds_[j]);
 
+		// sort indices in each row, needed by the sparse combine with core rows
+		for (int ii=0; ii<this->nrow_; ++ii)
+		{
+			int *rind = this->getMutableRowIndices(this->rowbeg_+ii);
+			int rlen = this->getRowLength(this->rowbeg_+ii);
+			for (int j=1; j<rlen; ++j)
+			{
+				if (rind[j-1] > rind[j])
+				{
+					CoinSort_2(rind,rind+rlen,this->getMutableRowElements(this->rowbeg_+ii));
+					break;
+				}
+			}
+		}
+
 		// if we had to make a reversed-ordered copy then delete it now
 		if (revOrdMatrix)
 		{
 			delete revOrdMatrix;
 		}
 	}
-	else
-		has_matrix_=false;
+
+	this->copyVectors(i_start,offset_dst,dclo,dcup,dobj,drlo,drup);
+
+	// sanity check: the counting pass was exact
+	assert(offset_dst == nels_);
+	assert(i_start+1 == nstrt_);
+}
+
+namespace {
+// orders stage triplets by row, column and input position
+class SmiTripletLess
+{
+public:
+	SmiTripletLess(const std::vector<int> &row, const std::vector<int> &col) : row_(row), col_(col) {}
+	bool operator()(int a, int b) const
+	{
+		if (row_[a] != row_[b])
+			return row_[a] < row_[b];
+		if (col_[a] != col_[b])
+			return col_[a] < col_[b];
+		return a < b;
+	}
+private:
+	const std::vector<int> &row_;
+	const std::vector<int> &col_;
+};
+}
+
+// constructor from matrix triplets
+// Only the triplets of the stage are looked at; the core rows of the stage
+// are not walked and no row-ordered matrix is built.
+SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
+				 int numTriplets, const int *rows, const int *cols, const double *els,
+				 CoinPackedVector *dclo,
+				 CoinPackedVector *dcup,
+				 CoinPackedVector *dobj,
+				 CoinPackedVector *drlo,
+				 CoinPackedVector *drup,
+				 SmiNodeDataArena *arena):
+				 stg_(stg),
+				 core_(core), isCoreNode_(false),
+				 numarrays_(5), // 5 arrays: dclo, dcup, dobj, drlo, drup
+				 nrow_(core->getNumRows(stg_)),
+				 ncol_(core->getNumCols(stg_)),
+				 rowbeg_(core->getRowStart(stg_)),
+				 colbeg_(core->getColStart(stg_)),
+				 arena_(arena),
+				 ptr_count(0),  // used for counted pointer
+				 interned_(false),internHash_(0)
+{
+	//so far no QP data
+	this->setHasQdata(false);
+	this->nqdata_=NULL;
+
+	// internal indices of the triplets in the stage, sorted by row and column
+	std::vector<int> irow(numTriplets), icol(numTriplets), order;
+	for (int k=0; k<numTriplets; ++k)
+	{
+		if (core->getRowStage(rows[k]) != stg)
+			continue;
+		irow[k] = core->getRowInternalIndex(rows[k]);
+		icol[k] = core->getColInternalIndex(cols[k]);
+		order.push_back(k);
+	}
+	std::sort(order.begin(),order.end(),SmiTripletLess(irow,icol));
+
+	// of repeated entries the last one given counts
+	int nmat=0;
+	for (unsigned int j=0; j<order.size(); ++j)
+	{
+		int k=order[j];
+		if (j+1<order.size() && irow[order[j+1]]==irow[k] && icol[order[j+1]]==icol[k])
+			continue;
+		order[nmat++]=k;
+	}
+	order.resize(nmat);
+
+	has_matrix_ = (nmat > 0);
+	nels_ = nmat + this->countVectorElements(dclo,dcup,dobj,drlo,drup);
+
+	// assign memory
+	this->assignMemory();
+
+	int offset_dst=0;
+	int i_start=0;
+
+	// Matrix rows of the stage
+	this->mat_strt_ = i_start;
+	if (has_matrix_)
+	{
+		for (int i=0; i<this->nrow_; ++i)
+		{
+			while (offset_dst<nmat && irow[order[offset_dst]]==this->rowbeg_+i)
+			{
+				int k=order[offset_dst];
+				this->dels_[offset_dst] = els[k];
+				this->inds_[offset_dst] = icol[k];
+				offset_dst++;
+			}
+			i_start++;
+			this->strt_[i_start] = offset_dst;
+		}
+	}
+
+	this->copyVectors(i_start,offset_dst,dclo,dcup,dobj,drlo,drup);
+
+	// sanity check: the counting pass was exact
+	assert(offset_dst == nels_);
+	assert(i_start+1 == nstrt_);
+}
+
+int
+SmiNodeData::countVectorElements(CoinPackedVector *dclo, CoinPackedVector *dcup, CoinPackedVector *dobj,
+								 CoinPackedVector *drlo, CoinPackedVector *drup)
+{
+	int nels=0;
+	CoinPackedVector *colVectors[3] = { dclo, dcup, dobj };
+	CoinPackedVector *rowVectors[2] = { drlo, drup };
+	for (int k=0; k<3; ++k)
+	{
+		if (!colVectors[k])
+			continue;
+		const int *vind = colVectors[k]->getIndices();
+		for (int j=0; j<colVectors[k]->getNumElements(); j++)
+			if (core_->getColStage(vind[j]) == stg_)
+				nels++;
+	}
+	for (int k=0; k<2; ++k)
+	{
+		if (!rowVectors[k])
+			continue;
+		const int *vind = rowVectors[k]->getIndices();
+		for (int j=0; j<rowVectors[k]->getNumElements(); j++)
+			if (core_->getRowStage(vind[j]) == stg_)
+				nels++;
+	}
+	return nels;
+}
+
+void
+SmiNodeData::copyVectors(int &i_start, int &offset_dst,
+						 CoinPackedVector *dclo, CoinPackedVector *dcup, CoinPackedVector *dobj,
+						 CoinPackedVector *drlo, CoinPackedVector *drup)
+{
+	int		*ind=NULL;
+	double	*els=NULL;
 
 	// Column Lower Bound
 	this->clo_strt_ = i_start;
@@ -496,10 +706,10 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 		for (int j=0; j<dclo->getNumElements(); j++)
 		{
 			int icol = ind[j];
-			if ( core->getColStage(icol) == stg )
+			if ( core_->getColStage(icol) == stg_ )
 			{
 				this->dels_[offset_dst] = els[j];
-				this->inds_[offset_dst] = core->getColInternalIndex(icol);
+				this->inds_[offset_dst] = core_->getColInternalIndex(icol);
 				offset_dst++;
 			}
 		}
@@ -516,10 +726,10 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 		for (int j=0; j<dcup->getNumElements(); j++)
 		{
 			int icol = ind[j];
-			if ( core->getColStage(icol) == stg )
+			if ( core_->getColStage(icol) == stg_ )
 			{
 				this->dels_[offset_dst] = els[j];
-				this->inds_[offset_dst] = core->getColInternalIndex(icol);
+				this->inds_[offset_dst] = core_->getColInternalIndex(icol);
 				offset_dst++;
 			}
 		}
@@ -536,10 +746,10 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 		for (int j=0; j<dobj->getNumElements(); j++)
 		{
 			int icol = ind[j];
-			if ( core->getColStage(icol) == stg )
+			if ( core_->getColStage(icol) == stg_ )
 			{
 				this->dels_[offset_dst] = els[j];
-				this->inds_[offset_dst] = core->getColInternalIndex(icol);
+				this->inds_[offset_dst] = core_->getColInternalIndex(icol);
 				offset_dst++;
 			}
 		}
@@ -556,10 +766,10 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 		for (int j=0; j<drlo->getNumElements(); j++)
 		{
 			int irow = ind[j];
-			if ( core->getRowStage(irow) == stg )
+			if ( core_->getRowStage(irow) == stg_ )
 			{
 				this->dels_[offset_dst] = els[j];
-				this->inds_[offset_dst] = core->getRowInternalIndex(irow);
+				this->inds_[offset_dst] = core_->getRowInternalIndex(irow);
 				offset_dst++;
 			}
 		}
@@ -576,24 +786,53 @@ SmiNodeData::SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 		for (int j=0; j<drup->getNumElements(); j++)
 		{
 			int irow = ind[j];
-			if ( core->getRowStage(irow) == stg )
+			if ( core_->getRowStage(irow) == stg_ )
 			{
 				this->dels_[offset_dst] = els[j];
-				this->inds_[offset_dst] = core->getRowInternalIndex(irow);
+				this->inds_[offset_dst] = core_->getRowInternalIndex(irow);
 				offset_dst++;
 			}
 		}
 	}
 	i_start++;
 	this->strt_[i_start] = offset_dst;
+}
+
+unsigned int
+SmiNodeData::contentHash()
+{
+	// FNV-1a over the stage, the starts, indices and element bytes
+	const int nstrt = rup_strt_+2;
+	const int nels = strt_[rup_strt_+1];
+	unsigned int h = 2166136261u;
+	h = (h ^ static_cast<unsigned int>(stg_)) * 16777619u;
+	h = (h ^ static_cast<unsigned int>(has_matrix_)) * 16777619u;
+	for (int i=0; i<nstrt; ++i)
+		h = (h ^ static_cast<unsigned int>(strt_[i])) * 16777619u;
+	for (int i=0; i<nels; ++i)
+		h = (h ^ static_cast<unsigned int>(inds_[i])) * 16777619u;
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(dels_);
+	for (size_t i=0; i<nels*sizeof(double); ++i)
+		h = (h ^ bytes[i]) * 16777619u;
+	return h;
+}
 
-	// return excess memory to the heap
-    void *temp_ptr = realloc(this->dels_,offset_dst*sizeof(double));
-    if (temp_ptr) 
-        this->dels_ = (double*)temp_ptr;
-    temp_ptr = realloc(this->inds_,offset_dst*sizeof(int));
-    if (temp_ptr)
-        this->inds_ = (int*)temp_ptr;
+bool
+SmiNodeData::sameContent(SmiNodeData *node)
+{
+	if (stg_ != node->stg_ || core_ != node->core_ || combineRule_ != node->combineRule_
+		|| isCoreNode_ || node->isCoreNode_ || hasQdata_ || node->hasQdata_
+		|| has_matrix_ != node->has_matrix_ || rup_strt_ != node->rup_strt_)
+		return false;
+	const int nstrt = rup_strt_+2;
+	for (int i=0; i<nstrt; ++i)
+		if (strt_[i] != node->strt_[i])
+			return false;
+	const int nels = strt_[rup_strt_+1];
+	for (int i=0; i<nels; ++i)
+		if (inds_[i] != node->inds_[i] || dels_[i] != node->dels_[i])
+			return false;
+	return true;
 }
 
 void SmiNodeData::addQuadraticObjective(int stg, SmiCoreData *smicore, SmiQuadraticData *sqdata)
@@ -697,6 +936,12 @@ int SmiNodeData::combineWithDenseCoreRow(double *dr,const int nels,const int *in
 {
 	return this->getCoreCombineRule()->Process(dr,this->getCore()->getNumCols(), nels,inds,dels,dest_dels,dest_indx);
 }
+int SmiNodeData::combineWithCoreRow(int i, double *dest_dels,int *dest_indx)
+{
+	SmiNodeData *cnode = this->getCore()->getNode(this->getStage());
+	return this->getCoreCombineRule()->Process(cnode->getRowLength(i),cnode->getRowIndices(i),cnode->getRowElements(i),
+		this->getRowLength(i),this->getRowIndices(i),this->getRowElements(i),dest_dels,dest_indx);
+}
 int SmiNodeData::combineWithDenseCoreRow(double *dr,CoinPackedVector *cpv,double *dels,int *indx)
 {
 	return getCoreCombineRule()->Process(dr,this->getCore()->getNumCols(),cpv,dels,indx);
@@ -772,6 +1017,14 @@ SmiNodeData::getDenseRow(int i) {
 			dv = new double[denseSize];  //this is deleted in the SmiNodeData destructor
 			dRowMap[i] = dv;
 		}
+
+		return getDenseRow(i,dv);
+}
+
+double *
+SmiNodeData::getDenseRow(int i, double *dv) {
+
+		int denseSize=this->getCore()->getNumCols();
 		const int  len = this->getRowLength(i);
 		const int *ind = this->getRowIndices(i);
 		const double *els = this->getRowElements(i);
@@ -780,7 +1033,7 @@ SmiNodeData::getDenseRow(int i) {
 		for (int j = 0; j < len; ++j)
 		    dv[ind[j]] = els[j];
 
-		return dRowMap[i];
+		return dv;
 }
 
 
@@ -788,8 +1041,22 @@ void
 SmiNodeData::assignMemory()
 {
 	
-	this->nstrt_    = (this->nrow_+1) + this->numarrays_;
-	
+	this->nstrt_    = 1 + this->numarrays_;
+	if (this->has_matrix_)
+		this->nstrt_ += this->nrow_;
+
+	if (this->arena_)
+	{
+		// one allocation: elements, then indices and starts
+		this->arena_->addRef();
+		char *block = static_cast<char *>(this->arena_->allocate(this->arenaBytes()));
+		this->dels_ = this->nels_ ? reinterpret_cast<double *>(block) : NULL;
+		this->inds_ = this->nels_ ? reinterpret_cast<int *>(block + this->nels_*sizeof(double)) : NULL;
+		this->strt_ = reinterpret_cast<int *>(block + this->nels_*(sizeof(double)+sizeof(int)));
+		memset(this->strt_,0,this->nstrt_*sizeof(int));
+		return;
+	}
+
 	if (this->nels_ == 0)
 	{
 		this->dels_ = NULL;
@@ -804,9 +1071,26 @@ SmiNodeData::assignMemory()
 	this->strt_     = (int *)   calloc(this->nstrt_ ,sizeof(int)   );
 }
 
+size_t
+SmiNodeData::arenaBytes()
+{
+	return this->nels_*(sizeof(double)+sizeof(int)) + this->nstrt_*sizeof(int);
+}
+
 void
 SmiNodeData::deleteMemory()
 {
+	if (this->arena_)
+	{
+		this->arena_->release(this->nels_ ? static_cast<void *>(this->dels_) : static_cast<void *>(this->strt_),this->arenaBytes());
+		if (this->arena_->deleteRef() == 0)
+			delete this->arena_;
+		this->arena_=NULL;
+		this->dels_=NULL;
+		this->inds_=NULL;
+		this->strt_=NULL;
+		return;
+	}
 	if (this->dels_)
 	{
 		free(this->dels_);
@@ -24,6 +24,48 @@ typedef int SmiStageIndex;
 
 class SmiCoreData;
 
+/** SmiNodeDataArena: bump allocator for the arrays of SmiNodeData
+
+The arrays of the node data of a model are carved out of large blocks,
+one allocation per node, and the blocks are freed together. The arena is
+reference counted: the model and every node data allocated in it hold a
+reference, so node data shared with a submodel keeps its arrays alive.
+Memory given back with release is only reused if it was the last
+allocation. Not thread safe.
+*/
+class SmiNodeDataArena
+{
+public:
+	SmiNodeDataArena(size_t blockSize = 1<<20);
+	~SmiNodeDataArena();
+
+	/// bytes are rounded up to a multiple of sizeof(double)
+	void *allocate(size_t bytes);
+	/// gives back the memory of an allocation
+	void release(void *p, size_t bytes);
+
+	int addRef() { return ++refCount_; }
+	int deleteRef() { return --refCount_; }
+
+	/// bytes in allocations not released
+	size_t getNumBytes() { return numBytes_; }
+	int getNumBlocks() { return static_cast<int>(blocks_.size()); }
+
+private:
+	SmiNodeDataArena(const SmiNodeDataArena &);
+	SmiNodeDataArena &operator=(const SmiNodeDataArena &);
+
+	static size_t roundUp(size_t bytes) { return (bytes + sizeof(double) - 1) & ~(sizeof(double) - 1); }
+
+	std::vector<char *> blocks_;
+	size_t blockSize_;
+	// free part of the current block
+	char *top_;
+	size_t left_;
+	size_t numBytes_;
+	int refCount_;
+};
+
 class SmiNodeData
 	//: public SmiLinearData
 {
@@ -38,6 +80,8 @@ public:
 		else return NULL;}
 	*/
 	double * getDenseRow(int i);
+	/// Same as getDenseRow(i), but fills the caller's array of length core->getNumCols() (thread safe)
+	double * getDenseRow(int i, double *dv);
 
 	inline SmiCoreData * getCore() { return core_;}
 	inline int getStage() { return stg_;}
@@ -77,6 +121,8 @@ public:
 			 return NULL;
 	 }
 	 int *getMutableRowIndices(int irow){
+		 if (interned_)
+			 return NULL;
 		 // using const_cast to stop warnings about cast-away constness
 		 return const_cast<int *>(getRowIndices(irow));
 	 }
@@ -100,6 +146,8 @@ public:
 			return NULL;
 		 }
 	 double *getMutableRowElements(int irow){
+		 if (interned_)
+			 return NULL;
 		 // using const_cast to stop warnings about cast-away constness
 		 return const_cast<double *>(getRowElements(irow));
 	 }
@@ -108,11 +156,22 @@ public:
 	 const double *getColLowerElements()   {return getElements(this->getCloStart());}
 	 const double *getColUpperElements()   {return getElements(this->getCupStart());}
 	 const double *getObjectiveElements()  {return getElements(this->getObjStart());}
+	 // mutable covers allow values of existing entries to be changed in place,
+	 // e.g. before SmiScnModel::updateOsiSolverData; they return NULL for
+	 // node data shared through SmiScnModel::setShareNodeData, as a change
+	 // would reach every tree node holding it
+	 double *getMutableRowLowerElements()   {return interned_ ? NULL : const_cast<double *>(getRowLowerElements());}
+	 double *getMutableRowUpperElements()   {return interned_ ? NULL : const_cast<double *>(getRowUpperElements());}
+	 double *getMutableColLowerElements()   {return interned_ ? NULL : const_cast<double *>(getColLowerElements());}
+	 double *getMutableColUpperElements()   {return interned_ ? NULL : const_cast<double *>(getColUpperElements());}
+	 double *getMutableObjectiveElements()  {return interned_ ? NULL : const_cast<double *>(getObjectiveElements());}
 
 
 	CoinPackedVector * combineWithCoreRow(CoinPackedVector *cr, CoinPackedVector *nr);
 	int combineWithDenseCoreRow(double *dr,CoinPackedVector *cpv,double *dels,int *indx);
 	int combineWithDenseCoreRow(double *dr,const int nels,const int *inds, const double *dels, double *dest_dels,int *dest_indx);
+	/// Sparse combine of row i with the core row; returns -1 if the combine rule has no sparse path
+	int combineWithCoreRow(int i, double *dest_dels,int *dest_indx);
 
 	SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
 				 const CoinPackedMatrix *const matrix,
@@ -120,7 +179,22 @@ public:
 				 CoinPackedVector *dcup,
 				 CoinPackedVector *dobj,
 				 CoinPackedVector *drlo,
-				 CoinPackedVector *drup);
+				 CoinPackedVector *drup,
+				 SmiNodeDataArena *arena = NULL);
+
+	/** Constructor from matrix triplets (row, column, element), in core
+	(external) indices like the matrix of the constructor above. Only the
+	triplets of rows in stage stg are used; of repeated entries the last
+	one counts. Costs O(k log k) for k triplets, independent of the size
+	of the matrix. */
+	SmiNodeData(SmiStageIndex stg, SmiCoreData *core,
+				 int numTriplets, const int *rows, const int *cols, const double *els,
+				 CoinPackedVector *dclo,
+				 CoinPackedVector *dcup,
+				 CoinPackedVector *dobj,
+				 CoinPackedVector *drlo,
+				 CoinPackedVector *drup,
+				 SmiNodeDataArena *arena = NULL);
 
 	void addQuadraticObjective(int stage, SmiCoreData *smicore, SmiQuadraticData *sqdata);
 
@@ -129,7 +203,28 @@ public:
 		
 	SmiQuadraticData *getQdata(){ return nqdata_;}
 
+	/**@name Reference count
+
+	Tree nodes holding this node data. Node data with equal content can be
+	shared by several tree nodes (see SmiScnModel::setShareNodeData); the
+	last tree node to go deletes it.
+	*/
+	//@{
 	int addPtr() { return ++ptr_count; }
+	int deletePtr() { return --ptr_count; }
+	int getPtrCount() { return ptr_count; }
+	//@}
+
+	/// hash of the stage and the packed data arrays
+	unsigned int contentHash();
+	/** Marks the node data as entered in a sharing table under hash h;
+	from then on it is read only (the mutable covers return NULL). */
+	void setInterned(unsigned int h) { interned_ = true; internHash_ = h; }
+	bool isInterned() { return interned_; }
+	/// hash the node data was entered under
+	unsigned int getInternHash() { return internHash_; }
+	/// true if node has the same stage, core, combine rule and data
+	bool sameContent(SmiNodeData *node);
 
 	~SmiNodeData();
 
@@ -139,6 +234,15 @@ protected:
 	//Memory assignment/deletion
 	void assignMemory();
 	void deleteMemory();
+	//bytes of the arrays in one arena allocation
+	size_t arenaBytes();
+	//number of vector elements that belong to the stage
+	int countVectorElements(CoinPackedVector *dclo, CoinPackedVector *dcup, CoinPackedVector *dobj,
+		CoinPackedVector *drlo, CoinPackedVector *drup);
+	//copies the vector elements of the stage, after the matrix rows
+	void copyVectors(int &i_start, int &offset_dst,
+		CoinPackedVector *dclo, CoinPackedVector *dcup, CoinPackedVector *dobj,
+		CoinPackedVector *drlo, CoinPackedVector *drup);
 
 	//Covers for starts of arrays
 	 const int getMatStart() { return mat_strt_;}
@@ -180,7 +284,7 @@ private:
 	int ncol_; //number of columns (of corresponding stage in core model)
 	int rowbeg_; //index, where rows of corresponding stage begins in the core model
 	int colbeg_; //index, where columns begin wrt to the columns of the corresponding stage in the core model
-	int nstrt_; //number of strt indices = numarray + nrow+1 (see assignMemory())
+	int nstrt_; //number of strt indices = numarray + 1, plus nrow if has_matrix_ (see assignMemory())
 	bool has_matrix_; //If this node has a matrix entry
 	int mat_strt_; //start arrays for corresponding entries
 	int clo_strt_;
@@ -191,8 +295,11 @@ private:
 	double * dels_; //concrete elements
 	int    * inds_; //indices for the elements
 	int    * strt_; //start array, where new row begins
+	SmiNodeDataArena *arena_; //arena holding dels_, inds_ and strt_, or NULL if they are malloc'ed
 
 	int ptr_count; //Propably for memory management?!
+	bool interned_; //in the sharing table of a model, under internHash_
+	unsigned int internHash_;
 
 	bool hasQdata_;
 	SmiQuadraticDataDC *nqdata_;
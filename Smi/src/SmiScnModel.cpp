@@ -7,8 +7,14 @@
 #include "CoinHelperFunctions.hpp"
 #include "CoinError.hpp"
 #include "CoinPackedVector.hpp"
+#include "CoinWarmStartBasis.hpp"
 #include <assert.h>
 #include <algorithm>
+#include <set>
+#include <map>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -37,6 +43,9 @@ int SmiScnNode::getCoreRowIndex(int i){
 
 SmiScnModel::~SmiScnModel()
 {
+    // no need to keep the share table up to date while everything goes
+    nodeDataTable_.clear();
+
     // loop to deleteNodes
     for_each(smiTree_.treeBegin(),smiTree_.treeEnd(),SmiScnModelDeleteNode(this));
 
@@ -75,6 +84,9 @@ SmiScnModel::~SmiScnModel()
 		free(rowNode);
 		//delete [] rowNode;
 
+    // node data shared with submodels keeps the arena
+    if (nodeArena_->deleteRef() == 0)
+        delete nodeArena_;
 }
 
 //Generates Tree Nodes with Data for given scenario
@@ -99,6 +111,29 @@ SmiScenarioIndex SmiScnModel::generateScenario(SmiCoreData *core,
                               SmiStageIndex branch, SmiScenarioIndex anc, double prob,
                               SmiCoreCombineRule *r)
 {
+	return generateScenarioPath(core,matrix,0,NULL,NULL,NULL,v_dclo,v_dcup,v_dobj,v_drlo,v_drup,branch,anc,prob,r);
+}
+
+SmiScenarioIndex SmiScnModel::generateScenario(SmiCoreData *core,
+                              int numTriplets, const int *rows, const int *cols, const double *els,
+                              CoinPackedVector *v_dclo, CoinPackedVector *v_dcup,
+                              CoinPackedVector *v_dobj,
+                              CoinPackedVector *v_drlo, CoinPackedVector *v_drup,
+                              SmiStageIndex branch, SmiScenarioIndex anc, double prob,
+                              SmiCoreCombineRule *r)
+{
+	return generateScenarioPath(core,NULL,numTriplets,rows,cols,els,v_dclo,v_dcup,v_dobj,v_drlo,v_drup,branch,anc,prob,r);
+}
+
+SmiScenarioIndex SmiScnModel::generateScenarioPath(SmiCoreData *core,
+                              CoinPackedMatrix *matrix,
+                              int numTriplets, const int *rows, const int *cols, const double *els,
+                              CoinPackedVector *v_dclo, CoinPackedVector *v_dcup,
+                              CoinPackedVector *v_dobj,
+                              CoinPackedVector *v_drlo, CoinPackedVector *v_drup,
+                              SmiStageIndex branch, SmiScenarioIndex anc, double prob,
+                              SmiCoreCombineRule *r)
+{
 
     // this coding takes branch to be the node that the scenario branches *from*
     --branch;
@@ -166,13 +201,46 @@ SmiScenarioIndex SmiScnModel::generateScenario(SmiCoreData *core,
     // Second: Connect the nodes with the present tree via the branching node, generates scenario index
     // Third: Add correct probabilities and set correct scenario index
 
+    // triplets bucketed by the stage of their row
+    int nstages = core->getNumStages();
+    vector<int> tripStart;
+    vector<int> tripRows(numTriplets), tripCols(numTriplets);
+    vector<double> tripEls(numTriplets);
+    if (!matrix)
+    {
+        tripStart.assign(nstages+1,0);
+        for (int k=0; k<numTriplets; ++k)
+            tripStart[core->getRowStage(rows[k])+1]++;
+        for (int t=0; t<nstages; ++t)
+            tripStart[t+1] += tripStart[t];
+        vector<int> next(tripStart.begin(),tripStart.end()-1);
+        for (int k=0; k<numTriplets; ++k)
+        {
+            int j = next[core->getRowStage(rows[k])]++;
+            tripRows[j] = rows[k];
+            tripCols[j] = cols[k];
+            tripEls[j] = els[k];
+        }
+    }
+
     int t;
     for (t=branch+1; t<core->getNumStages(); t++) //Christian: Generate SmiScnNodes until the leaf nodes are reached
     {
         // generate new data node for given stage
-        SmiNodeData *node = new SmiNodeData(t,core,matrix,
-            v_dclo,v_dcup,v_dobj,v_drlo,v_drup);
+        SmiNodeData *node;
+        if (matrix)
+            node = new SmiNodeData(t,core,matrix,
+                v_dclo,v_dcup,v_dobj,v_drlo,v_drup,nodeArena_);
+        else
+        {
+            int k0 = tripStart[t];
+            int nt = tripStart[t+1]-k0;
+            node = new SmiNodeData(t,core,nt,nt ? &tripRows[k0] : NULL,nt ? &tripCols[k0] : NULL,nt ? &tripEls[k0] : NULL,
+                v_dclo,v_dcup,v_dobj,v_drlo,v_drup,nodeArena_);
+        }
         node->setCoreCombineRule(r);
+        if (shareNodeData_)
+            node = internNodeData(node);
         // generate new tree node
         SmiScnNode *tnode = new SmiScnNode(node);
         node_vec.push_back(tnode);
@@ -280,6 +348,7 @@ std::pair<double,double*> SmiScnModel::solveEV(OsiSolverInterface *osiSolver, do
     // We create a new osiSolver Handle at this point. 
     OsiSolverInterface* tempPtr = osiStoch_;
     osiStoch_ = osiSolver->clone(false);
+    numNodesLoaded_ = 0;
 
     //Clean up previous stuff.
     delete[] dclo_;
@@ -369,219 +438,116 @@ std::pair<double,double*> SmiScnModel::solveEV(OsiSolverInterface *osiSolver, do
 
 double SmiScnModel::solveEEV(OsiSolverInterface *osiSolver, double objSense)
 {
-    OsiSolverInterface* tempPtr = osiStoch_;
-    osiStoch_ = osiSolver->clone(false);
-    std::pair<double, double* > evResult(solveEV(osiSolver, objSense)); //We create a new osiSolver object in here (osiStoch_)
-    
-
-    // save the column solution for stage-1-columns
-    int numStage1Cols = core_->getColStart(1);
-    double * colSolution = evResult.second;
+    std::pair<double, double* > evResult(solveEV(osiSolver, objSense));
 
+    // fix stage-1-columns to the values of the evp and solve every scenario
+    vector<double> objValues;
+    solveScenarios(osiSolver,objSense,evResult.second,objValues);
 
-#pragma region EEVP
+    // sum up the solution values (multiplied with probabilities)
     double eev = 0; // the value of the EEVP
+    for (int i = 0; i < this->smiTree_.getNumScenarios(); i++)
+        eev += objValues[i] * getLeafNode(i)->getProb();
 
-    //Clean up previous stuff.
-    delete[] dclo_;
-    delete[] dcup_;
-    delete[] dobj_;
-    delete[] drlo_;
-    delete[] drup_;
-    delete matrix_;
-
-    // initialize arrays
-    this->dclo_ = new double[this->core_->getNumCols()];
-    this->dcup_ = new double[this->core_->getNumCols()];
-    this->dobj_ = new double[this->core_->getNumCols()];
-    this->drlo_ = new double[this->core_->getNumRows()];
-    this->drup_ = new double[this->core_->getNumRows()];
-
-    int tempNels = 0; //= nels_ ? nels_: this->core_->getNumCols()*this->core_->getNumRows(); //nels_ got set by det.eq. generations. If this is not done, we have a problem.
-    for (int i = 0; i < this->core_->getNumStages(); i++)
-        tempNels += this->maxNelsPerScenInStage[i];
-
-    // loop over all scenarios and solve each of it individually TODO: This can get easily parallelized.
-    for( int i = 0; i < this->smiTree_.getNumScenarios(); i++) {
-        // We have an empty model (zero cols,rows,els)
-        ncol_=0;
-        nrow_=0;
-        nels_=0;
-        osiStoch_->reset();
-        // initialize row-ordered matrix arrays
-        this->dels_ = new double[tempNels+1]; //TODO: Remove the +1 as it should work without it.. something is wrong there during addition of the elements..
-        this->indx_ = new int[tempNels];
-        this->rstrt_ = new int[this->core_->getNumRows()+1];
-        this->rstrt_[0] = 0;
-        // Get all nodes for this scenario
-        std::vector<SmiScnNode*>& nodes = smiTree_.getScenario(i);
-        // Call addNode on all these nodes
-        for (unsigned int i = 0; i < nodes.size(); i++) {
-            addNode(nodes[i],true);
-        }
-
-        matrix_ = new CoinPackedMatrix(false,0,0);
-        int *len=NULL;
-        // Assign values from current arrays (which get nulled thereafter)
-        matrix_->assignMatrix(false,ncol_,nrow_,nels_,
-            dels_,indx_,rstrt_,len);
-        // pass data to osiStoch
-        osiStoch_->loadProblem(*matrix_,dclo_,dcup_,dobj_,drlo_,drup_); //This works only for same-dimensional subproblems.
-
-        // load integer values in solver
-        for (unsigned int i = 0; i < intIndices.size(); i++) {
-            osiStoch_->setInteger(intIndices[i]);
-        }
-
-        // fix stage-1-columns to the values of the evp
-        for (int col = 0; col < numStage1Cols; col++) {
-            if (this->core_->getColStage(col) == 0) {
-                osiStoch_->setColBounds(col, colSolution[col], colSolution[col]);
-            }
-        }
-
-        //Set objSense
-        osiStoch_->setObjSense(objSense);
-        osiStoch_->initialSolve(); //Solve this problem. We need objSense..
-
-        // sum up the solution values (multiplied with probabilities)
-        eev += osiStoch_->getObjValue() * nodes[nodes.size()-1]->getProb();
-
-        //Delete new-ed objects
-        delete matrix_;
-        delete [] this->dels_;
-        delete [] this->indx_;
-        delete [] this->rstrt_;
-        matrix_ = 0; dels_ = 0; indx_ = 0; rstrt_ = 0;
-
-        //Print out Matrix.. if in Debug Mode
-        //TODO: Define proper Debug Mode..
-        //TODO: Printout obj-functions
-#ifdef NDEBUG
-        for (int mi = 0; mi < osiStoch_->getMatrixByRow()->getMinorDim();mi++){
-            std::cout << osiStoch_->getObjCoefficients()[mi] << "*x" << mi << " + ";
-        }
-        std::cout << std::endl;
-        for (int mi = 0; mi < osiStoch_->getMatrixByRow()->getMajorDim(); mi++){
-            printf("\n%g <= ", osiStoch_->getRowLower()[mi]);
-            for (int mj = 0; mj < osiStoch_->getMatrixByRow()->getMinorDim(); mj++){
-                printf("%g ",osiStoch_->getMatrixByRow()->getCoefficient(mi,mj));
-            }
-            printf("<= %g",osiStoch_->getRowUpper()[mi]);
-        }
-        printf("\n Matrix printed \n");
-        for (int mi = 0; mi < osiStoch_->getNumCols(); mi++) {
-            printf("\n%g <= %d <= %g",osiStoch_->getColLower()[mi],mi,osiStoch_->getColUpper()[mi]);
-
-        }
-        printf("\n");
-#endif
-    }
-#pragma endregion EEVP;
-
-    delete [] colSolution;
-    delete osiStoch_;
-    osiStoch_ = tempPtr;
+    delete [] evResult.second;
     return eev;
 }
 
 std::vector< std::pair<double,double> > SmiScnModel::solveWS(OsiSolverInterface *osiSolver, double objSense) 
 {
-    OsiSolverInterface* tempPtr = osiStoch_;
-    osiStoch_ = osiSolver->clone(false); // We copy the existing solverHandle, so we have to delete it at the end?
+    vector<double> objValues;
+    solveScenarios(osiSolver,objSense,NULL,objValues);
 
-    //Clean up previous stuff.
-    delete[] dclo_;
-    delete[] dcup_;
-    delete[] dobj_;
-    delete[] drlo_;
-    delete[] drup_;
-    delete matrix_;
+    std::vector<std::pair<double,double> > solutionValues;
+    solutionValues.reserve(objValues.size());
+    for (unsigned int i = 0; i < objValues.size(); i++)
+        solutionValues.push_back(make_pair(objValues[i],getLeafNode(i)->getProb()));
+    return solutionValues;
+}
 
-    // initialize arrays
-    this->dclo_ = new double[this->core_->getNumCols()];
-    this->dcup_ = new double[this->core_->getNumCols()];
-    this->dobj_ = new double[this->core_->getNumCols()];
-    this->drlo_ = new double[this->core_->getNumRows()];
-    this->drup_ = new double[this->core_->getNumRows()];
+void SmiScnModel::solveScenarios(OsiSolverInterface *osiSolver, double objSense, const double *fixedCols, vector<double> &objValues)
+{
+    int nscen = this->smiTree_.getNumScenarios();
+    objValues.resize(nscen);
 
-    int tempNels = 0; //= nels_ ? nels_: this->core_->getNumCols()*this->core_->getNumRows(); //nels_ got set by det.eq. generations. If this is not done, we have a problem.
-    for (int i = 0; i < this->core_->getNumStages(); i++)
-        tempNels += this->maxNelsPerScenInStage[i];
+    // every scenario problem has the dimensions of the core
+    int ncol = this->core_->getNumCols();
+    int nrow = this->core_->getNumRows();
+    vector<int> intCols;
+    for (int t = 0; t < this->core_->getNumStages(); t++) {
+        vector<int> stageInts = this->core_->getIntCols(t);
+        for (unsigned int i = 0; i < stageInts.size(); i++)
+            intCols.push_back(stageInts[i] + this->core_->getColStart(t));
+    }
+    int nfixed = fixedCols ? this->core_->getColStart(1) : 0;
 
-    std::vector<std::pair<double,double> > solutionValues;
-    solutionValues.reserve(this->smiTree_.getNumScenarios());
-
-
-    // loop over all scenarios and solve each of it individually
-    for( int i = 0; i < this->smiTree_.getNumScenarios(); i++) {
-        // We have an empty model (zero cols,rows,els)
-        ncol_=0;
-        nrow_=0;
-        nels_=0;
-        //TODO: Create a new SolverObject by using the type of osiStoch. Need to load osiCoreData in the newly created osiStoch..
-        osiStoch_->reset();
-        // initialize row-ordered matrix arrays
-        this->dels_ = new double[tempNels]; 
-        this->indx_ = new int[tempNels];
-        this->rstrt_ = new int[this->core_->getNumRows()+1];
-        this->rstrt_[0] = 0;
-        // Get all nodes for this scenario
-        std::vector<SmiScnNode*>& nodes = smiTree_.getScenario(i);
-        // Call addNode on all these nodes
-        for (unsigned int i = 0; i < nodes.size(); i++) {
-            addNode(nodes[i],true);
-        }
+    // loop over all scenarios and solve each of it individually;
+    // a worker keeps its solver and arrays for all of its scenarios
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads_) if(numThreads_ > 1)
+#endif
+    {
+        OsiSolverInterface *osi = osiSolver->clone(false);
+        double *clo = new double[ncol];
+        double *cup = new double[ncol];
+        double *obj = new double[ncol];
+        double *rlo = new double[nrow];
+        double *rup = new double[nrow];
+        int *rstrt = new int[nrow+1];
+        double *denseRow = new double[ncol+1];
+        // scratch arrays of updateScenarioSolver
+        double *dwork = warmScenarios_ ? new double[5*ncol+2*nrow+2] : NULL;
+        int *iwork = warmScenarios_ ? new int[2*ncol+2] : NULL;
+        vector<double> dels;
+        vector<int> indx;
+        // nodes of the scenario in osi, when it is kept for the next one
+        vector<SmiScnNode *> loaded;
+        vector<SmiScnNode *> path;
+        // contiguous blocks, so consecutive scenarios of a worker share tree nodes
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int is = 0; is < nscen; is++) {
+            if (warmScenarios_ && !loaded.empty()) {
+                // apply the differences to the loaded scenario and resolve from its basis
+                getScenarioNodes(is,path);
+                updateScenarioSolver(osi,loaded,path,clo,cup,obj,rlo,rup,denseRow,dwork,iwork);
+                osi->resolve();
+            }
+            else {
+                int nels = fillScenarioArrays(is,clo,cup,obj,rlo,rup,dels,indx,rstrt,denseRow);
 
-        matrix_ = new CoinPackedMatrix(false,0,0);
-        int *len=NULL;
-        // Assign values from current arrays (which get nulled thereafter)
-        matrix_->assignMatrix(false,ncol_,nrow_,nels_,
-            dels_,indx_,rstrt_,len);
-        // pass data to osiStoch
-        osiStoch_->loadProblem(*matrix_,dclo_,dcup_,dobj_,drlo_,drup_); //This works only for same-dimensional subproblems.
-
-        // load integer values in solver
-        for (unsigned int i = 0; i < intIndices.size(); i++) {
-            osiStoch_->setInteger(intIndices[i]);
-        }
-        //Set objSense
-        osiStoch_->setObjSense(objSense);
-        osiStoch_->initialSolve(); //Solve this problem. We need objSense..
-        solutionValues.push_back(make_pair<double,double>(osiStoch_->getObjValue(),nodes.back()->getProb()));
+                // fix stage-1-columns to the given values
+                for (int col = 0; col < nfixed; col++) {
+                    if (this->core_->getColStage(col) == 0) {
+                        clo[col] = cup[col] = fixedCols[col];
+                    }
+                }
 
-        //Delete new-ed objects
-        delete matrix_;
-        delete [] this->dels_;
-        delete [] this->indx_;
-        delete [] this->rstrt_;
-        matrix_ = 0; dels_ = 0; indx_ = 0; rstrt_ = 0;
-
-        //Print out Matrix.. if in Debug Mode
-        //TODO: Define proper Debug Mode..
-        //TODO: Printout obj-functions
-#ifdef NDEBUG
-        for (int mi = 0; mi < osiStoch_->getMatrixByRow()->getMinorDim();mi++){
-            std::cout << osiStoch_->getObjCoefficients()[mi] << "*x" << mi << " + ";
-        }
-        std::cout << std::endl;
-        for (int mi = 0; mi < osiStoch_->getMatrixByRow()->getMajorDim(); mi++){
-            printf("\n%g <= ", osiStoch_->getRowLower()[mi]);
-            for (int mj = 0; mj < osiStoch_->getMatrixByRow()->getMinorDim(); mj++){
-                printf("%g ",osiStoch_->getMatrixByRow()->getCoefficient(mi,mj));
+                CoinPackedMatrix matrix(false,ncol,nrow,nels,&dels[0],&indx[0],rstrt,NULL);
+                osi->loadProblem(matrix,clo,cup,obj,rlo,rup);
+                for (unsigned int i = 0; i < intCols.size(); i++) {
+                    osi->setInteger(intCols[i]);
+                }
+                //Set objSense
+                osi->setObjSense(objSense);
+                osi->initialSolve();
+                if (warmScenarios_)
+                    getScenarioNodes(is,loaded);
             }
-            printf("<= %g",osiStoch_->getRowUpper()[mi]);
+            objValues[is] = osi->getObjValue();
         }
-        printf("\n Matrix printed \n");
-        for (int mi = 0; mi < osiStoch_->getNumCols(); mi++) {
-            printf("\n%g <= %d <= %g",osiStoch_->getColLower()[mi],mi,osiStoch_->getColUpper()[mi]);
-        }
-        printf("\n");
-#endif
+        delete [] clo;
+        delete [] cup;
+        delete [] obj;
+        delete [] rlo;
+        delete [] rup;
+        delete [] rstrt;
+        delete [] denseRow;
+        delete [] dwork;
+        delete [] iwork;
+        delete osi;
     }
-    delete osiStoch_;
-    osiStoch_ = tempPtr;
-    return solutionValues;
 }
 
 ClpModel * SmiScnModel::loadQuadraticSolverData()
@@ -604,17 +570,276 @@ SmiScnModel::loadOsiSolverData()
     osiStoch_->reset();
 	generateSolverArrays();
 	    // pass data to osiStoch
-    osiStoch_->loadProblem(*matrix_,dclo_,dcup_,dobj_,drlo_,drup_);
+    passSolverData();
 
     // load integer values in solver
     for (unsigned int i = 0; i < intIndices.size(); i++) {
         osiStoch_->setInteger(intIndices[i]);
     }
+
+    // remember which nodes are in the solver, for appendScenariosToOsi
+    numNodesLoaded_ = static_cast<int>(smiTree_.wholeTree().size());
 	return osiStoch_;
 }
 
+void
+SmiScnModel::passSolverData()
+{
+    if (assignSolverData_)
+    {
+        // the solver takes ownership; matrix_ and the arrays come back NULL
+        osiStoch_->assignProblem(matrix_,dclo_,dcup_,dobj_,drlo_,drup_);
+    }
+    else
+        osiStoch_->loadProblem(*matrix_,dclo_,dcup_,dobj_,drlo_,drup_);
+}
+
+OsiSolverInterface *
+SmiScnModel::appendScenariosToOsi()
+{
+    // full build if the solver does not hold the current det. eq.
+    if (!numNodesLoaded_ || nqels_)
+        return loadOsiSolverData();
+
+    vector<SmiScnNode *> &nodes = smiTree_.wholeTree();
+    int nnodes = static_cast<int>(nodes.size());
+    if (nnodes == numNodesLoaded_)
+        return osiStoch_;
+
+    // dimensions of the loaded det. eq.; generateScenario has already
+    // added the new nodes to ncol_, nrow_ and (as upper bound) nels_
+    int ncolOld = osiStoch_->getNumCols();
+    int nrowOld = osiStoch_->getNumRows();
+    int ncolNew = ncol_;
+    int nrowNew = nrow_;
+    int nelsBound = nels_ - osiStoch_->getNumElements();
+    unsigned int nintOld = static_cast<unsigned int>(intIndices.size());
+
+    // without a model copy (see setAssignSolverData) the arrays below are scratch
+    bool keepCopy = (matrix_ != NULL);
+    assert(!keepCopy || ncolOld == matrix_->getNumCols());
+    assert(!keepCopy || nrowOld == matrix_->getNumRows());
+
+    CoinWarmStart *ws = osiStoch_->getWarmStart();
+
+    // grow the column and row arrays, keeping the loaded values
+    double *d;
+    d = new double[ncolNew]; if (keepCopy) memcpy(d,dclo_,ncolOld*sizeof(double)); delete[] dclo_; dclo_ = d;
+    d = new double[ncolNew]; if (keepCopy) memcpy(d,dcup_,ncolOld*sizeof(double)); delete[] dcup_; dcup_ = d;
+    d = new double[ncolNew]; if (keepCopy) memcpy(d,dobj_,ncolOld*sizeof(double)); delete[] dobj_; dobj_ = d;
+    d = new double[nrowNew]; if (keepCopy) memcpy(d,drlo_,nrowOld*sizeof(double)); delete[] drlo_; drlo_ = d;
+    d = new double[nrowNew]; if (keepCopy) memcpy(d,drup_,nrowOld*sizeof(double)); delete[] drup_; drup_ = d;
+
+    // rescale objective of loaded nodes to the new total probability
+    for (int k=0; k<numNodesLoaded_; ++k)
+    {
+        SmiScnNode *tnode = nodes[k];
+        if (tnode->isVirtualNode())
+            continue;
+        double prob = tnode->getProb()/this->totalProb_;
+        if (prob == tnode->getModelProb())
+            continue;
+        tnode->setModelProb(prob);
+        int coff = tnode->getColStart();
+        tnode->getNode()->copyObjective(dobj_+coff);
+        for (int j=coff; j<coff+tnode->getNumCols(); ++j)
+        {
+            dobj_[j] *= prob;
+            osiStoch_->setObjCoeff(j,dobj_[j]);
+        }
+    }
+
+    // new rows go into scratch arrays; row starts are kept for all rows
+    // so that fillNode can index them by det. eq. row
+    this->dels_ = new double[nelsBound+1];
+    this->indx_ = new int[nelsBound+1];
+    this->rstrt_ = new int[nrowNew+1];
+    this->rstrt_[nrowOld] = 0;
+
+    ncol_ = ncolOld;
+    nrow_ = nrowOld;
+    int nels = 0;
+    for (int k=numNodesLoaded_; k<nnodes; ++k)
+    {
+        if (placeNode(nodes[k],false))
+            nels += fillNode(nodes[k],nels,0,NULL);
+    }
+    assert(ncol_ == ncolNew);
+    assert(nrow_ == nrowNew);
+    assert(nels <= nelsBound);
+
+    // pass the new columns (empty in the loaded rows) and the new rows
+    int *colStarts = new int[ncolNew-ncolOld+1];
+    CoinFillN(colStarts,ncolNew-ncolOld+1,0);
+    osiStoch_->addCols(ncolNew-ncolOld,colStarts,NULL,NULL,
+        dclo_+ncolOld,dcup_+ncolOld,dobj_+ncolOld);
+    osiStoch_->addRows(nrowNew-nrowOld,rstrt_+nrowOld,indx_,dels_,
+        drlo_+nrowOld,drup_+nrowOld);
+    delete[] colStarts;
+
+    for (unsigned int i = nintOld; i < intIndices.size(); i++) {
+        osiStoch_->setInteger(intIndices[i]);
+    }
+
+    // keep the model's copy of the det. eq. in step with the solver
+    if (keepCopy)
+    {
+        matrix_->setDimensions(nrowOld,ncolNew);
+        matrix_->appendRows(nrowNew-nrowOld,rstrt_+nrowOld,indx_,dels_,ncolNew);
+    }
+    else
+    {
+        delete[] dclo_;
+        delete[] dcup_;
+        delete[] dobj_;
+        delete[] drlo_;
+        delete[] drup_;
+        dclo_ = dcup_ = dobj_ = drlo_ = drup_ = NULL;
+    }
+    nels_ = osiStoch_->getNumElements();
+
+    delete[] dels_;
+    delete[] indx_;
+    delete[] rstrt_;
+    dels_ = NULL;
+    indx_ = NULL;
+    rstrt_ = NULL;
+
+    // warm start: old basis, new rows basic and new columns at lower bound
+    CoinWarmStartBasis *basis = dynamic_cast<CoinWarmStartBasis *>(ws);
+    if (basis)
+    {
+        basis->resize(nrowNew,ncolNew);
+        osiStoch_->setWarmStart(basis);
+    }
+    delete ws;
+
+    numNodesLoaded_ = nnodes;
+    return osiStoch_;
+}
+
+int
+SmiScnModel::updateOsiSolverData()
+{
+    // full build if the solver does not hold the current det. eq.
+    if (!numNodesLoaded_ || nqels_)
+    {
+        loadOsiSolverData();
+        return osiStoch_->getNumCols()+osiStoch_->getNumRows();
+    }
+
+    vector<SmiScnNode *> &nodes = smiTree_.wholeTree();
+    SmiCoreData *core = nodes[0]->getNode()->getCore();
+
+    // work arrays for one node
+    int maxCols=0;
+    int maxRows=0;
+    for (int t=0; t<core->getNumStages(); ++t)
+    {
+        maxCols = max(maxCols,core->getNumCols(t));
+        maxRows = max(maxRows,core->getNumRows(t));
+    }
+    double *clo = new double[maxCols];
+    double *cup = new double[maxCols];
+    double *obj = new double[maxCols];
+    double *rlo = new double[maxRows];
+    double *rup = new double[maxRows];
+
+    int nchanged=0;
+    for (int k=0; k<numNodesLoaded_; ++k)
+    {
+        SmiScnNode *tnode = nodes[k];
+        if (tnode->isVirtualNode())
+            continue;
+        SmiNodeData *node = tnode->getNode();
+
+        node->copyColLower(clo);
+        node->copyColUpper(cup);
+        node->copyObjective(obj);
+        node->copyRowLower(rlo);
+        node->copyRowUpper(rup);
+
+        double prob = tnode->getProb()/this->totalProb_;
+        tnode->setModelProb(prob);
+
+        // loaded values: the model's copy, or the solver's if there is none
+        int coff = tnode->getColStart();
+        const double *lclo = (dclo_ ? dclo_ : osiStoch_->getColLower()) + coff;
+        const double *lcup = (dcup_ ? dcup_ : osiStoch_->getColUpper()) + coff;
+        const double *lobj = (dobj_ ? dobj_ : osiStoch_->getObjCoefficients()) + coff;
+        vector<int> changedCols;
+        vector<int> changedObj;
+        for (int j=0; j<tnode->getNumCols(); ++j)
+        {
+            obj[j] *= prob;
+            if (clo[j] != lclo[j] || cup[j] != lcup[j])
+                changedCols.push_back(j);
+            if (obj[j] != lobj[j])
+                changedObj.push_back(j);
+        }
+
+        int roff = tnode->getRowStart();
+        const double *lrlo = (drlo_ ? drlo_ : osiStoch_->getRowLower()) + roff;
+        const double *lrup = (drup_ ? drup_ : osiStoch_->getRowUpper()) + roff;
+        vector<int> changedRows;
+        for (int i=0; i<tnode->getNumRows(); ++i)
+        {
+            if (rlo[i] != lrlo[i] || rup[i] != lrup[i])
+                changedRows.push_back(i);
+        }
+
+        // pass the differences
+        for (unsigned int c=0; c<changedCols.size(); ++c)
+        {
+            int j = changedCols[c];
+            if (dclo_)
+            {
+                dclo_[coff+j] = clo[j];
+                dcup_[coff+j] = cup[j];
+            }
+            osiStoch_->setColBounds(coff+j,clo[j],cup[j]);
+        }
+        for (unsigned int c=0; c<changedObj.size(); ++c)
+        {
+            int j = changedObj[c];
+            if (dobj_)
+                dobj_[coff+j] = obj[j];
+            osiStoch_->setObjCoeff(coff+j,obj[j]);
+        }
+        for (unsigned int c=0; c<changedRows.size(); ++c)
+        {
+            int i = changedRows[c];
+            if (drlo_)
+            {
+                drlo_[roff+i] = rlo[i];
+                drup_[roff+i] = rup[i];
+            }
+            osiStoch_->setRowBounds(roff+i,rlo[i],rup[i]);
+        }
+        nchanged += static_cast<int>(changedCols.size()+changedObj.size()+changedRows.size());
+    }
+
+    delete[] clo;
+    delete[] cup;
+    delete[] obj;
+    delete[] rlo;
+    delete[] rup;
+
+    // new scenarios
+    if (numNodesLoaded_ < static_cast<int>(nodes.size()))
+    {
+        int ncolOld = osiStoch_->getNumCols();
+        int nrowOld = osiStoch_->getNumRows();
+        appendScenariosToOsi();
+        nchanged += osiStoch_->getNumCols()-ncolOld + osiStoch_->getNumRows()-nrowOld;
+    }
+
+    return nchanged;
+}
+
 void SmiScnModel::generateSolverArrays()
 {
+    numNodesLoaded_ = 0;
 
     delete[] dclo_;
     delete[] dcup_;
@@ -623,38 +848,161 @@ void SmiScnModel::generateSolverArrays()
     delete[] drup_;
     delete matrix_;
 
-    // initialize arrays
+    vector<SmiScnNode *> &nodes = smiTree_.wholeTree();
+    int nnodes = static_cast<int>(nodes.size());
+
+    // First pass: place the nodes in tree order, which sets the row and
+    // column offsets of every node and gives the exact det. eq. dimensions.
+    // The generated counts size the node maps, so they are allocated once.
+    reserveNodeMaps(ncol_,nrow_);
+    ncol_=0;
+    nrow_=0;
+    nels_=0;
+
+    vector<bool> included(nnodes);
+    for (int k=0; k<nnodes; ++k)
+        included[k] = placeNode(nodes[k],false);
+
+    fillSolverArrays(nodes,included);
+}
+
+void
+SmiScnModel::fillSolverArrays(vector<SmiScnNode *> &nodes, vector<bool> &included)
+{
+    int nnodes = static_cast<int>(nodes.size());
+
+    if (colOrdered_)
+        generateColumnOrderedArrays(nodes,included);
+    else
+        generateRowOrderedArrays(nodes,included);
+
+    // virtual nodes: columns only, with their bounds and no cost
+    for (int k=0; k<nnodes; ++k)
+    {
+        if (included[k])
+            continue;
+        SmiScnNode *tnode = nodes[k];
+        int coff = tnode->getColStart();
+        tnode->getNode()->copyColLower(dclo_+coff);
+        tnode->getNode()->copyColUpper(dcup_+coff);
+        CoinFillN(dobj_+coff,tnode->getNumCols(),0.0);
+    }
+}
+
+void
+SmiScnModel::generateRowOrderedArrays(vector<SmiScnNode *> &nodes, vector<bool> &included)
+{
+    int nnodes = static_cast<int>(nodes.size());
+
+    // work arrays: core stage block and stochastic entries of a node
+    int maxWork=0;
+    for (int k=0; k<nnodes; ++k)
+    {
+        if (!included[k])
+            continue;
+        SmiNodeData *node = nodes[k]->getNode();
+        maxWork = max(maxWork,node->getCore()->getNumCols()+node->getNumMatrixElements());
+    }
+
+    // tree nodes sharing node data have the same number of elements:
+    // count them once, at the first node holding the data
+    vector<int> firstUse(nnodes);
+    std::map<SmiNodeData *,int> dataUse;
+    for (int k=0; k<nnodes; ++k)
+        firstUse[k] = included[k] ? dataUse.insert(std::make_pair(nodes[k]->getNode(),k)).first->second : k;
+
+    // Second pass: exact number of elements of every node, merged
+    // stochastic rows included
+    vector<int> nodeEls(nnodes,0);
+    vector<int> nodeQels(nnodes,0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads_) if(numThreads_ > 1)
+#endif
+    {
+        double *wdels = new double[maxWork+1];
+        int *windx = new int[maxWork+1];
+        // dense work row -- getDenseRow(i) is not thread safe
+        double *denseRow = numThreads_ > 1 ? new double[maxWork+1] : NULL;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,16)
+#endif
+        for (int k=0; k<nnodes; ++k)
+        {
+            if (!included[k] || firstUse[k]!=k)
+                continue;
+            nodeEls[k] = countNodeElements(nodes[k],wdels,windx,denseRow);
+            SmiNodeData *cnode = nodes[k]->getNode()->getCore()->getNode(nodes[k]->getStage());
+            if (cnode->hasQdata())
+                nodeQels[k] = cnode->getQdata()->getNumEls();
+        }
+        delete [] wdels;
+        delete [] windx;
+        delete [] denseRow;
+    }
+    for (int k=0; k<nnodes; ++k)
+    {
+        if (included[k] && firstUse[k]!=k)
+        {
+            nodeEls[k] = nodeEls[firstUse[k]];
+            nodeQels[k] = nodeQels[firstUse[k]];
+        }
+    }
+
+    // element offsets of the nodes
+    vector<int> elsStart(nnodes+1);
+    vector<int> qelsStart(nnodes+1);
+    elsStart[0]=0;
+    qelsStart[0]=0;
+    for (int k=0; k<nnodes; ++k)
+    {
+        elsStart[k+1] = elsStart[k] + nodeEls[k];
+        qelsStart[k+1] = qelsStart[k] + nodeQels[k];
+    }
+    this->nels_max = elsStart[nnodes];
+
+    // all det. eq. arrays are allocated once, with their exact sizes
     this->dclo_ = new double[this->ncol_];
     this->dcup_ = new double[this->ncol_];
     this->dobj_ = new double[this->ncol_];
     this->drlo_ = new double[this->nrow_];
     this->drup_ = new double[this->nrow_];
-
-    // initialize row-ordered matrix arrays
-    this->dels_ = new double[this->nels_+1]; //TODO: Remove the +1 as it should work without it.. something is wrong there during addition of the elements..
-    this->indx_ = new int[this->nels_];
+    this->dels_ = new double[this->nels_max];
+    this->indx_ = new int[this->nels_max];
     this->rstrt_ = new int[this->nrow_+1];
     this->rstrt_[0] = 0;
-    this->nels_max = nels_;
 
-	int nqels_max;
+    this->nqels_ = qelsStart[nnodes];
 	if (this->nqels_)
 	{
 		this->qdels_= new double[this->nqels_];
 		this->qindx_= new int[this->nqels_];
 		this->qstart_= new int[this->ncol_+1];
-		nqels_max=this->nqels_;
-		this->nqels_=0;
 		memset(this->qstart_,0,(this->ncol_+1)*sizeof(int));
-		
 	}
 
-    ncol_=0;
-    nrow_=0;
-    nels_=0;
+    // Third pass: every node fills its own slice of the arrays
+    vector<int> fillEls(nnodes,0);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads_) if(numThreads_ > 1)
+#endif
+    {
+        double *denseRow = numThreads_ > 1 ? new double[maxWork+1] : NULL;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,16)
+#endif
+        for (int k=0; k<nnodes; ++k)
+        {
+            if (!included[k])
+                continue;
+            fillEls[k] = fillNode(nodes[k],elsStart[k],qelsStart[k],denseRow);
+        }
+        delete [] denseRow;
+    }
 
-    // loop to addNodes
-    for_each(smiTree_.treeBegin(),smiTree_.treeEnd(),SmiScnModelAddNode(this));
+    // sanity check: the counting pass was exact
+    assert(fillEls == nodeEls);
+    assert(this->rstrt_[this->nrow_] == this->nels_max);
+    nels_ = this->nels_max;
 
     //What happens if no ScenarioTree is present, but a core model is?
     matrix_ = new CoinPackedMatrix(false,0,0);
@@ -686,13 +1034,56 @@ void SmiScnModel::generateSolverArrays()
 
 //Christian: Generate Submodel Specified by Stage and Scenario Number
 // This Model contains only constraints for the specified stage and scenario numbers..
-//TODO: Not yet implemented
 OsiSolverInterface *
 SmiScnModel::loadOsiSolverDataForSubproblem(int stage, int scenStart)
 {
+    SmiTreeNode<SmiScnNode *> *subroot = smiTree_.find(scenStart,stage);
+
+    // ancestors first, root to parent
+    vector<SmiScnNode *> nodes;
+    for (SmiTreeNode<SmiScnNode *> *n=subroot->getParent(); n; n=n->getParent())
+        nodes.push_back(n->getDataPtr());
+    reverse(nodes.begin(),nodes.end());
+
+    // subtree in preorder, so parents are placed before their children
+    vector<SmiTreeNode<SmiScnNode *> *> stack(1,subroot);
+    while (!stack.empty())
+    {
+        SmiTreeNode<SmiScnNode *> *n = stack.back();
+        stack.pop_back();
+        nodes.push_back(n->getDataPtr());
+        for (SmiTreeNode<SmiScnNode *> *c=n->getChild(); c; c=c->getSibling())
+            stack.push_back(c);
+    }
+
+    return loadSubproblemNodes(nodes,subroot->depth());
+}
+
+OsiSolverInterface *
+SmiScnModel::loadOsiSolverDataForSubproblem(int stage, int scenStart, int scenEnd)
+{
+    assert(scenStart < scenEnd && scenEnd <= getNumScenarios());
+
+    // path of every scenario, up to the first node already taken
+    vector<SmiScnNode *> nodes;
+    set<SmiTreeNode<SmiScnNode *> *> taken;
+    vector<SmiScnNode *> path;
+    for (int s=scenStart; s<scenEnd; ++s)
+    {
+        path.clear();
+        for (SmiTreeNode<SmiScnNode *> *n=smiTree_.getLeaf(s); n && taken.insert(n).second; n=n->getParent())
+            path.push_back(n->getDataPtr());
+        nodes.insert(nodes.end(),path.rbegin(),path.rend());
+    }
+
+    return loadSubproblemNodes(nodes,stage);
+}
 
-    //TODO Declare new SolverInterface?
+OsiSolverInterface *
+SmiScnModel::loadSubproblemNodes(vector<SmiScnNode *> &nodes, int stage)
+{
     osiStoch_->reset();
+    numNodesLoaded_ = 0;
 
     delete[] dclo_;
     delete[] dcup_;
@@ -701,175 +1092,43 @@ SmiScnModel::loadOsiSolverDataForSubproblem(int stage, int scenStart)
     delete[] drup_;
     delete matrix_;
 
-    // initialize arrays with correct dimensions
-    //this->core_->nColInStage_
-    this->dclo_ = new double[this->ncol_];
-    this->dcup_ = new double[this->ncol_];
-    this->dobj_ = new double[this->ncol_];
-    this->drlo_ = new double[this->nrow_];
-    this->drup_ = new double[this->nrow_];
+    int nnodes = static_cast<int>(nodes.size());
 
-    // initialize row-ordered matrix arrays
-    this->dels_ = new double[this->nels_];
-    this->indx_ = new int[this->nels_];
-    this->rstrt_ = new int[this->nrow_+1];
-    this->rstrt_[0] = 0;
-    this->nels_max = nels_;
+    // nodes before the subproblem stage only supply columns
+    vector<bool> wasIncluded(nnodes);
+    for (int k=0; k<nnodes; ++k)
+    {
+        wasIncluded[k] = nodes[k]->getInclude();
+        if (nodes[k]->getStage() < stage)
+            nodes[k]->setIncludeOff();
+    }
+
+    // integer columns of the subproblem are kept apart from the model's
+    unsigned int nint = static_cast<unsigned int>(intIndices.size());
 
     ncol_=0;
     nrow_=0;
     nels_=0;
+    vector<bool> included(nnodes);
+    for (int k=0; k<nnodes; ++k)
+        included[k] = placeNode(nodes[k],false);
 
-    // loop to addNodes
-    for_each(smiTree_.treeBegin(),smiTree_.treeEnd(),SmiScnModelAddNode(this));
-
-    matrix_ = new CoinPackedMatrix(false,0,0);
-    int *len=NULL;
-    matrix_->assignMatrix(false,ncol_,nrow_,nels_,
-        dels_,indx_,rstrt_,len);
+    fillSolverArrays(nodes,included);
 
     // pass data to osiStoch
-    osiStoch_->loadProblem(CoinPackedMatrix(*matrix_),dclo_,dcup_,dobj_,drlo_,drup_);
+    passSolverData();
+    for (unsigned int i = nint; i < intIndices.size(); i++) {
+        osiStoch_->setInteger(intIndices[i]);
+    }
+    intIndices.resize(nint);
+
+    for (int k=0; k<nnodes; ++k)
+    {
+        if (wasIncluded[k])
+            nodes[k]->setIncludeOn();
+    }
 
     return osiStoch_;
-    ////	SmiScnNode tnode;
-    //	SmiNodeData *node = tnode->getNode();
-    //
-    //	// set offsets for current node
-    //	tnode->setColOffset(ncol_);
-    //	tnode->setRowOffset(nrow_);
-    //
-    //	if (tnode->isVirtualNode())
-    //	{
-    //		// update column count
-    //		ncol_ += tnode->getNumCols();
-    //		return;
-    //	}
-    //
-    //	// OsiSolverInterface *osi = this->osiStoch_;
-    //	SmiCoreData *core = node->getCore();
-    //
-    //	// get stage and associated core node
-    //	int stg = node->getStage();
-    //	SmiNodeData *cnode = core->getNode(stg);
-    //
-    //	// pretty sure this is an error? //Christian: At a first glance, looks like it..
-    //	core->copyRowLower(drlo_+nrow_,stg);
-    //	core->copyRowUpper(drup_+nrow_,stg);
-    //	core->copyColLower(dclo_+ncol_,stg);
-    //	core->copyColUpper(dcup_+ncol_,stg);
-    //	core->copyObjective(dobj_+ncol_,stg);
-    //
-    //
-    //	node->copyColLower(dclo_+ncol_);
-    //	node->copyColUpper(dcup_+ncol_);
-    //	node->copyObjective(dobj_+ncol_);
-    //	node->copyRowLower(drlo_+nrow_);
-    //	node->copyRowUpper(drup_+nrow_);
-    //
-    //	// multiply obj coeffs by node probability and normalize
-    //	double prob = tnode->getProb()/this->totalProb_;
-    //	tnode->setModelProb(prob);
-    //
-    //	for(int j=ncol_; j<ncol_+core->getNumCols(stg); ++j)
-    //		dobj_[j] *= prob;
-    //
-    //
-    //	vector<int> stochColStart(stg+1);
-    //	SmiScnNode *pnode=tnode;
-    //
-    //	stochColStart[stg]=ncol_;
-    //	for (int t=stg-1; t>0; t--)
-    //	{
-    //		pnode=pnode->getParent();
-    //		stochColStart[t] = pnode->getColStart();
-    //	}
-    //
-    //	// row counter
-    //	int rowCount=nrow_;
-    //
-    //	// add rows to matrix
-    //	for (int i=core->getRowStart(stg); i<core->getRowStart(stg+1) ; i++)
-    //	{
-    //		if (stg)
-    //		{
-    //			// build row explicitly into sparse arrays
-    //			int rowStart=this->rstrt_[rowCount];
-    //			int rowNumEls=0;
-    //			if (node->getRowLength(i))
-    //			{
-    //				double *denseCoreRow = cnode->getDenseRow(i);
-    //				rowNumEls=node->combineWithDenseCoreRow(denseCoreRow,node->getRowLength(i),node->getRowIndices(i),node->getRowElements(i),dels_+rowStart,indx_+rowStart);
-    //			}
-    //			else
-    //			{
-    //				const double *cels=cnode->getRowElements(i);
-    //				const int *cind=cnode->getRowIndices(i);
-    //				const int len=cnode->getRowLength(i);
-    //				memcpy(dels_+rowStart,cels,sizeof(double)*len);
-    //				memcpy(indx_+rowStart,cind,sizeof(int)*len);
-    //				rowNumEls=len;
-    //			}
-    //
-    //
-    //			rowCount++;
-    //			nels_+=rowNumEls;
-    //			this->rstrt_[rowCount] = nels_;
-    //
-    //			// coefficients of new row
-    //			int *indx = indx_+rowStart;
-    //
-    //			// stage starts
-    //			int t=stg;
-    //			int jlo=core->getColStart(stg);
-    //
-    //			// net offset to be added to indices
-    //			int coff= stochColStart[stg]-jlo;
-    //
-    //			if(coff)
-    //			{
-    //				// TODO -- decide if better to sort COL indices in core
-    //#if 1
-    //
-    //				// main loop iterates backwards through indices
-    //				for (int j=rowNumEls-1; j>-1;--j)
-    //				{
-    //					// get new offset from parent node when crossing stage bndy
-    //					while (indx[j]<jlo)
-    //					{
-    //						jlo = core->getColStart(--t);
-    //						coff = stochColStart[t] - jlo;
-    //					}
-    //
-    //					// add offset to index
-    //					indx[j]+=coff;
-    //				}
-    //#else
-    //				for (int j=0; j<rowNumEls; ++j)
-    //				{
-    //					t = core->getColStage(indx[j]);
-    //					indx[j] += stochColStart[t] - core->getColStart(t);
-    //				}
-    //#endif
-    //			}
-    //		}
-    //		else
-    //		{
-    //			// build row explicitly into sparse arrays
-    //			const double *els = cnode->getRowElements(i);
-    //			const int *ind = cnode->getRowIndices(i);
-    //			const int len = cnode->getRowLength(i);
-    //
-    //			int rowStart=this->rstrt_[rowCount];
-    //
-    //			memcpy(dels_+rowStart,els,sizeof(double)*len);
-    //			memcpy(indx_+rowStart,ind,sizeof(int)*len);
-    //
-    //			rowCount++;
-    //			nels_+=len;
-    //			this->rstrt_[rowCount] = nels_;
-    //
-    //		}
 }
 
 
@@ -877,11 +1136,74 @@ void
 SmiScnModel::deleteNode(SmiScnNode *tnode)
 {
     //cout << "Deleting node from scenario " << tnode->getScenarioIndex() << " Stage " <<  tnode->getNode()->getStage() << endl;
+
+    // the last reference to shared node data goes: take it out of the table
+    SmiNodeData *node = tnode->getNode();
+    if (node && node->isInterned() && node->getPtrCount()==1)
+    {
+        typedef std::multimap<unsigned int, SmiNodeData *>::iterator TableIter;
+        std::pair<TableIter,TableIter> range = nodeDataTable_.equal_range(node->getInternHash());
+        for (TableIter it=range.first; it!=range.second; ++it)
+        {
+            if (it->second == node)
+            {
+                nodeDataTable_.erase(it);
+                break;
+            }
+        }
+    }
     delete tnode;
 }
 
+SmiNodeData *
+SmiScnModel::internNodeData(SmiNodeData *node)
+{
+    // quadratic data is not compared
+    if (node->hasQdata())
+        return node;
+
+    unsigned int h = node->contentHash();
+    typedef std::multimap<unsigned int, SmiNodeData *>::iterator TableIter;
+    std::pair<TableIter,TableIter> range = nodeDataTable_.equal_range(h);
+    for (TableIter it=range.first; it!=range.second; ++it)
+    {
+        if (it->second->sameContent(node))
+        {
+            delete node;
+            return it->second;
+        }
+    }
+    nodeDataTable_.insert(std::make_pair(h,node));
+    node->setInterned(h);
+    return node;
+}
+
 void
 SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
+{
+    // set offsets for current node; virtual nodes only count columns
+    if (!placeNode(tnode,notDetEq))
+        return;
+
+    SmiNodeData *cnode = tnode->getNode()->getCore()->getNode(tnode->getStage());
+    if (cnode->hasQdata())
+    {
+        //sanity check
+        assert(this->qstart_[tnode->getColStart()]==nqels_);
+    }
+
+    // copy data into det. eq. arrays
+    nels_ += fillNode(tnode,nels_,nqels_,NULL);
+    if (cnode->hasQdata())
+        nqels_ += cnode->getQdata()->getNumEls();
+
+    // sanity check
+    //assert(! ( this->nels_ > this->nels_max ) );
+
+}
+
+bool
+SmiScnModel::placeNode(SmiScnNode *tnode,bool notDetEq)
 {
 
     SmiNodeData *node = tnode->getNode();
@@ -889,25 +1211,15 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
     // OsiSolverInterface *osi = this->osiStoch_;
     SmiCoreData *core = node->getCore();
 
-	// get stage and associated core node 
+	// get stage
     int stg = node->getStage();
-    SmiNodeData *cnode = core->getNode(stg);
 
 	this->numNodes++;
 	node->setNodeIndex(this->numNodes);
-    if (this->columnNode==NULL) {
-	    this->columnNode = (int *)malloc(sizeof(int)*(ncol_+core->getNumCols(stg)));
-    }
-    else {
-	    this->columnNode = (int *)realloc(this->columnNode,sizeof(int)*(ncol_+core->getNumCols(stg)));
-    }
-    if (this->rowNode==NULL) {
-	    this->rowNode = (int *)malloc(sizeof(int)*(nrow_+core->getNumRows(stg)));
-    }
-    else {
-	    this->rowNode = (int *)realloc(this->rowNode,sizeof(int)*(nrow_+core->getNumRows(stg)));
-    }
-
+    // node maps grow geometrically; generateSolverArrays reserves them up front
+    if (ncol_+core->getNumCols(stg) > columnNodeCap || nrow_+core->getNumRows(stg) > rowNodeCap)
+        reserveNodeMaps(max(2*columnNodeCap,ncol_+core->getNumCols(stg)),
+            max(2*rowNodeCap,nrow_+core->getNumRows(stg)));
 	
     for(int j=ncol_; j<ncol_+core->getNumCols(stg); ++j)
         columnNode[j] = node->getNodeIndex();
@@ -925,7 +1237,7 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
     {
         // update column count
         ncol_ += tnode->getNumCols();
-        return;
+        return false;
     }
 
 
@@ -943,6 +1255,41 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
         this->addIntIndice(intCols[i] + ncol_);
     }
 
+    // multiply obj coeffs by node probability and normalize
+    double prob = !notDetEq ? tnode->getProb()/this->totalProb_ : 1; //Christian: TODO: totalProb_ = Summer aller absoluten W'keiten (am Ende muesste die bei 1 sein..?!)
+    tnode->setModelProb(prob);
+
+    // update row, col counts
+    ncol_ += core->getNumCols(stg);
+    nrow_ += core->getNumRows(stg);
+
+    return true;
+}
+
+int
+SmiScnModel::fillNode(SmiScnNode *tnode, int nelsStart, int nqelsStart, double *denseRow)
+{
+    fillNodeVectors(tnode,nqelsStart);
+
+    // rows of the node go to their final position in the row-ordered arrays
+    return fillNodeRows(tnode,dels_+nelsStart,indx_+nelsStart,rstrt_+tnode->getRowStart(),nelsStart,denseRow);
+}
+
+void
+SmiScnModel::fillNodeVectors(SmiScnNode *tnode, int nqelsStart)
+{
+
+    SmiNodeData *node = tnode->getNode();
+    SmiCoreData *core = node->getCore();
+
+	// get stage and associated core node 
+    int stg = node->getStage();
+    SmiNodeData *cnode = core->getNode(stg);
+
+    // offsets of this node in the det. eq.
+    int ncol = tnode->getColStart();
+    int nrow = tnode->getRowStart();
+
     // pretty sure this is an error? //Christian: At a first glance, looks like it..
     //Christian: Copy and Combine with Core-Arrays to create Arrays for current scenario and stage
     //core->copyRowLower(drlo_+nrow_,stg);
@@ -951,34 +1298,33 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
     //core->copyColUpper(dcup_+ncol_,stg);
     //core->copyObjective(dobj_+ncol_,stg);
     //Copy Core Data and Replace Stochastic Data to obtain a copy for the det. eq.
-    node->copyColLower(dclo_+ncol_);
-    node->copyColUpper(dcup_+ncol_);
-    node->copyObjective(dobj_+ncol_);
-    node->copyRowLower(drlo_+nrow_);
-    node->copyRowUpper(drup_+nrow_);
+    node->copyColLower(dclo_+ncol);
+    node->copyColUpper(dcup_+ncol);
+    node->copyObjective(dobj_+ncol);
+    node->copyRowLower(drlo_+nrow);
+    node->copyRowUpper(drup_+nrow);
 
 
-    // multiply obj coeffs by node probability and normalize
-    double prob = !notDetEq ? tnode->getProb()/this->totalProb_ : 1; //Christian: TODO: totalProb_ = Summer aller absoluten W'keiten (am Ende muesste die bei 1 sein..?!)
-    tnode->setModelProb(prob);
+    // multiply obj coeffs by node probability (set in placeNode)
+    double prob = tnode->getModelProb();
 
-    for(int j=ncol_; j<ncol_+core->getNumCols(stg); ++j)
+    for(int j=ncol; j<ncol+core->getNumCols(stg); ++j)
         dobj_[j] *= prob;
 
 	if (cnode->hasQdata())
 	{
-		//sanity check
-		assert(this->qstart_[ncol_]==nqels_);
+		// quadratic element counter
+		int nqels = nqelsStart;
 
 		// column counter
-		int nqcol = ncol_;
+		int nqcol = ncol;
 
 		//get quadratic data for core node
 		SmiQuadraticData *qdata = cnode->getQdata();
 
 		
 		//calculate the core node indices offset for this stage
-		int coff = ncol_-core->getColStart(stg);
+		int coff = ncol-core->getColStart(stg);
 
 		//loop over core columns in the current stage
 		for (int j=core->getColStart(stg);j<core->getColStart(stg+1);++j)
@@ -987,13 +1333,13 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
 			for (int iels=qdata->getQDstarts()[j];iels<qdata->getQDstarts()[j+1];++iels)
 			{
 				// copy the element multiplied by the probability
-				this->qdels_[nqels_]=qdata->getQDels()[iels]*prob;
+				this->qdels_[nqels]=qdata->getQDels()[iels]*prob;
 
 				// copy the index with offset
-				this->qindx_[nqels_]=qdata->getQDindx()[iels] + coff;
+				this->qindx_[nqels]=qdata->getQDindx()[iels] + coff;
 
 				// increment the qelement pointer
-				++nqels_;
+				++nqels;
 			}
 
 			//increment the qcolumn pointer and do a column counting sanity check
@@ -1001,40 +1347,56 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
 			assert(nqcol == coff+j+1);
 
 			//record the starting element for the next column 
-			this->qstart_[nqcol]=nqels_;
+			this->qstart_[nqcol]=nqels;
 		}
 	}
 		
+}
+
+int
+SmiScnModel::fillNodeRows(SmiScnNode *tnode, double *dels, int *indx, int *rstrt, int base, double *denseRow, bool coreCols)
+{
+
+    SmiNodeData *node = tnode->getNode();
+    SmiCoreData *core = node->getCore();
+    int stg = node->getStage();
+    SmiNodeData *cnode = core->getNode(stg);
+    int ncol = tnode->getColStart();
+
     //Christian: Get Column Start Values for every stage less than current stage. This depends on the ordering of nodes in the nodes array..
     vector<int> stochColStart(stg+1);
     SmiScnNode *pnode=tnode;
 
-    stochColStart[stg]=ncol_;
+    stochColStart[stg]=ncol;
     for (int t=stg-1; t>0; t--)
     {
         pnode=pnode->getParent();
         stochColStart[t] = pnode->getColStart();
     }
+    if (coreCols)
+    {
+        for (int t=0; t<=stg; t++)
+            stochColStart[t] = core->getColStart(t);
+    }
 
-    // row counter : initialized with number of rows counted so far
-    int rowCount=nrow_;
+    // row counter : local to this node
+    int rowCount=0;
+
+    // element counter : local to this node
+    int nels=0;
 
     // add rows to det. eq. matrix for current stage
     for (int i=core->getRowStart(stg); i<core->getRowStart(stg+1) ; i++)
     {
 
         // build row explicitly into sparse arrays
-        int rowStart=this->rstrt_[rowCount];
+        int rowStart=nels;
         int rowNumEls=0;
         //Christian: In my opinion the if/else is the same for all rows in a given stage
         //Christian: If row has stochastic coefficients (that implies that we are not in stage one which means 0 here)
         if (stg && node->getRowLength(i))
-        {	//Christian: If I understood it correctly, a dense row is inserted (a row with values for all collumns)
-            double *denseCoreRow = cnode->getDenseRow(i); //Christian: Why is the dense core row needed?? I don't get it..
-            //I think the DenseCoreRow is needed because it simplifies things a little bit on the cost of performance
-            //TODO: Change methods to use CompressedRowStorage for the core row also.. (Performance)
-            //Christian: Returned row is a row that contains only non-zero elements, so it is not dense anymore
-            rowNumEls=node->combineWithDenseCoreRow(denseCoreRow,node->getRowLength(i),node->getRowIndices(i),node->getRowElements(i),dels_+rowStart,indx_+rowStart);
+        {
+            rowNumEls=combineNodeRow(node,i,dels+rowStart,indx+rowStart,denseRow);
         }
         //Christian: If row does not have stochastic coefficients, copy values from core node for current stage (no combination needed..)
         else
@@ -1042,15 +1404,15 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
             const double *cels=cnode->getRowElements(i);
             const int *cind=cnode->getRowIndices(i);
             const int len=cnode->getRowLength(i);
-            memcpy(dels_+rowStart,cels,sizeof(double)*len);
-            memcpy(indx_+rowStart,cind,sizeof(int)*len);
+            memcpy(dels+rowStart,cels,sizeof(double)*len);
+            memcpy(indx+rowStart,cind,sizeof(int)*len);
             rowNumEls=len;
         }
 
         //preparation for the next row
         rowCount++;
-        nels_+=rowNumEls;
-        this->rstrt_[rowCount] = nels_;
+        nels+=rowNumEls;
+        rstrt[rowCount] = base+nels;
         //done with preparations for the next row
 
         //Coefficients of the newly added row needs to get adjusted, as they differ from the core model
@@ -1058,7 +1420,7 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
         //This can only be done if we are not in the first stage aka stage 0
         if (stg) {
 
-            int *indx = indx_+rowStart;
+            int *rindx = indx+rowStart;
 
             // We start with the current stage
             int t=stg;
@@ -1077,33 +1439,876 @@ SmiScnModel::addNode(SmiScnNode *tnode,bool notDetEq /* = false */)
                     // get new offset from parent node when crossing stage boundary
                     // This happens, if the index of the coefficient at hand is less than the index of the first coefficient belonging to the current stage.
                     // In this case the index at hand is actually from an variable of an lower stage. Repeat procedure, until index is at the correct stage.
-                    while (indx[j]<jlo)
+                    while (rindx[j]<jlo)
                     {
                         jlo = core->getColStart(--t);
                         coff = stochColStart[t] - jlo;
                     }
 
                     // add offset to index
-                    indx[j]+=coff;
+                    rindx[j]+=coff;
                 }
 #else
                 for (int j=0; j<rowNumEls; ++j)
                 {
-                    t = core->getColStage(indx[j]);
-                    indx[j] += stochColStart[t] - core->getColStart(t);
+                    t = core->getColStage(rindx[j]);
+                    rindx[j] += stochColStart[t] - core->getColStart(t);
                 }
 #endif
             }
         }
 
     }
-    // update row, col counts
-    ncol_ += core->getNumCols(stg);
-    nrow_ += core->getNumRows(stg);
 
-    // sanity check
-    //assert(! ( this->nels_ > this->nels_max ) );
+    return nels;
+}
+
+int
+SmiScnModel::fillScenarioArrays(int scen, double *clo, double *cup, double *obj, double *rlo, double *rup,
+    vector<double> &dels, vector<int> &indx, int *rstrt, double *denseRow)
+{
+    vector<SmiScnNode *> path;
+    getScenarioNodes(scen,path);
+    int nelsBound = 0;
+    for (unsigned int k = 0; k < path.size(); ++k)
+    {
+        SmiNodeData *node = path[k]->getNode();
+        nelsBound += node->getCore()->getNode(node->getStage())->getNumMatrixElements() + node->getNumMatrixElements();
+    }
+    if (static_cast<int>(dels.size()) < nelsBound+1)
+    {
+        dels.resize(nelsBound+1);
+        indx.resize(nelsBound+1);
+    }
+
+    // stages in order, so the row starts increase
+    int nels = 0;
+    rstrt[0] = 0;
+    for (unsigned int k = 0; k < path.size(); ++k)
+    {
+        SmiScnNode *tnode = path[k];
+        SmiNodeData *node = tnode->getNode();
+        SmiCoreData *core = node->getCore();
+        int stg = node->getStage();
+        int coff = core->getColStart(stg);
+        int roff = core->getRowStart(stg);
+        node->copyColLower(clo+coff);
+        node->copyColUpper(cup+coff);
+        node->copyObjective(obj+coff);
+        node->copyRowLower(rlo+roff);
+        node->copyRowUpper(rup+roff);
+        nels += fillNodeRows(tnode,&dels[nels],&indx[nels],rstrt+roff,nels,denseRow,true);
+    }
+    return nels;
+}
+
+int
+SmiScnModel::fillNodeArrays(SmiScnNode *tnode, double *clo, double *cup, double *obj, double *rlo, double *rup,
+    vector<double> &dels, vector<int> &indx, int *rstrt, double *denseRow)
+{
+    SmiNodeData *node = tnode->getNode();
+    int nelsBound = node->getCore()->getNode(node->getStage())->getNumMatrixElements() + node->getNumMatrixElements();
+    if (static_cast<int>(dels.size()) < nelsBound+1)
+    {
+        dels.resize(nelsBound+1);
+        indx.resize(nelsBound+1);
+    }
+    node->copyColLower(clo);
+    node->copyColUpper(cup);
+    node->copyObjective(obj);
+    node->copyRowLower(rlo);
+    node->copyRowUpper(rup);
+    rstrt[0] = 0;
+    return fillNodeRows(tnode,&dels[0],&indx[0],rstrt,0,denseRow,true);
+}
+
+void
+SmiScnModel::getScenarioNodes(int scen, vector<SmiScnNode *> &path)
+{
+    // walk up from the leaf; smiTree_.getScenario is not thread safe
+    path.clear();
+    for (SmiScnNode *tnode = getLeafNode(scen); tnode; tnode = tnode->getParent())
+        path.push_back(tnode);
+    reverse(path.begin(),path.end());
+}
+
+double
+SmiScnModel::reduceScenarios(int numScenarios, SmiScenarioReduction::Method method)
+{
+    return reduceTree(numScenarios,COIN_DBL_MAX,method);
+}
+
+double
+SmiScnModel::reduceScenariosToTolerance(double tolerance, SmiScenarioReduction::Method method)
+{
+    return reduceTree(1,tolerance,method);
+}
+
+namespace {
+// stochastic entry of a node: bounds, objective and rhs are (-kind-1, core index),
+// matrix entries (row, column)
+struct SmiNodeEntry
+{
+    int i;
+    int j;
+    double value;
+};
+
+void
+addNodeEntries(vector<SmiNodeEntry> &e, int kind, int len, const int *ind, const double *els)
+{
+    for (int k=0; k<len; ++k)
+    {
+        SmiNodeEntry entry = { -kind-1, ind[k], els[k] };
+        e.push_back(entry);
+    }
+}
+
+void
+getNodeEntries(SmiNodeData *node, vector<SmiNodeEntry> &e)
+{
+    e.clear();
+    addNodeEntries(e,0,node->getColLowerLength(),node->getColLowerIndices(),node->getColLowerElements());
+    addNodeEntries(e,1,node->getColUpperLength(),node->getColUpperIndices(),node->getColUpperElements());
+    addNodeEntries(e,2,node->getObjectiveLength(),node->getObjectiveIndices(),node->getObjectiveElements());
+    addNodeEntries(e,3,node->getRowLowerLength(),node->getRowLowerIndices(),node->getRowLowerElements());
+    addNodeEntries(e,4,node->getRowUpperLength(),node->getRowUpperIndices(),node->getRowUpperElements());
+    SmiCoreData *core = node->getCore();
+    int t = node->getStage();
+    for (int i=core->getRowStart(t); i<core->getRowStart(t+1); ++i)
+    {
+        const int *ind = node->getRowIndices(i);
+        const double *els = node->getRowElements(i);
+        for (int k=0; k<node->getRowLength(i); ++k)
+        {
+            SmiNodeEntry entry = { i, ind[k], els[k] };
+            e.push_back(entry);
+        }
+    }
+}
+
+// core value of an entry of stage t
+double
+getCoreEntry(SmiCoreData *core, int t, int i, int j)
+{
+    switch (i)
+    {
+    case -1: return core->getDenseColLower(t)[j-core->getColStart(t)];
+    case -2: return core->getDenseColUpper(t)[j-core->getColStart(t)];
+    case -3: return core->getDenseObjCoefficients(t)[j-core->getColStart(t)];
+    case -4: return core->getDenseRowLower(t)[j-core->getRowStart(t)];
+    case -5: return core->getDenseRowUpper(t)[j-core->getRowStart(t)];
+    }
+    SmiNodeData *cnode = core->getNode(t);
+    const int *ind = cnode->getRowIndices(i);
+    for (int k=0; k<cnode->getRowLength(i); ++k)
+        if (ind[k] == j)
+            return cnode->getRowElements(i)[k];
+    return 0.0;
+}
+
+// value of a stochastic entry of a node, combined with the core; pos is
+// the entry's place in the list of stochastic entries of all stages
+struct SmiNodeValue
+{
+    int pos;
+    double value;
+};
+
+/* Distance between scenarios: the l1 distance of their stochastic data,
+   every bound, objective, rhs and matrix entry that is stochastic in some
+   node of its stage, combined with the core. Two scenarios only differ in
+   the stages where their nodes differ, and there only in the entries of
+   the two nodes, so the distance is a merge of the node entries, with the
+   core value where one of the nodes has none. Memory is the stochastic
+   data of the distinct nodes and one path per scenario. */
+class SmiScnNodeDistance : public SmiScenarioDistance
+{
+public:
+    SmiScnNodeDistance(SmiScnModel *smi, int numThreads);
+    virtual double distance(int i, int j);
+
+private:
+    double nodeDistance(int u, int v);
+
+    int nstages_;
+    // node data of scenario s in stage t: path_[s*nstages_+t], -1 for core data
+    vector<int> path_;
+    // entries of every distinct node data, by position
+    vector<vector<SmiNodeValue> > values_;
+    // core values of the stochastic entries
+    vector<double> core_;
+};
+
+SmiScnNodeDistance::SmiScnNodeDistance(SmiScnModel *smi, int numThreads)
+{
+    SmiCoreData *core = smi->getRootNode()->getNode()->getCore();
+    nstages_ = core->getNumStages();
+    int nscen = smi->getNumScenarios();
+
+    // distinct node data along the scenario paths
+    map<SmiNodeData *,int> dataIndex;
+    vector<SmiNodeData *> data;
+    vector<SmiScnNode *> path;
+    path_.assign(static_cast<size_t>(nscen)*nstages_,-1);
+    for (int s=0; s<nscen; ++s)
+    {
+        smi->getScenarioNodes(s,path);
+        assert(static_cast<int>(path.size()) == nstages_);
+        for (int t=0; t<nstages_; ++t)
+        {
+            SmiNodeData *node = path[t]->getNode();
+            if (node->isCoreNode())
+                continue;
+            map<SmiNodeData *,int>::iterator it = dataIndex.find(node);
+            if (it == dataIndex.end())
+            {
+                it = dataIndex.insert(make_pair(node,static_cast<int>(data.size()))).first;
+                data.push_back(node);
+            }
+            path_[static_cast<size_t>(s)*nstages_+t] = it->second;
+        }
+    }
+
+    // entries that are stochastic in some node, stage by stage
+    vector<SmiNodeEntry> entries;
+    typedef map<pair<int,int>,int> SmiEntryMap;
+    vector<SmiEntryMap> pos(nstages_);
+    for (unsigned int k=0; k<data.size(); ++k)
+    {
+        getNodeEntries(data[k],entries);
+        for (unsigned int e=0; e<entries.size(); ++e)
+            pos[data[k]->getStage()].insert(make_pair(make_pair(entries[e].i,entries[e].j),0));
+    }
+    for (int t=0; t<nstages_; ++t)
+    {
+        for (SmiEntryMap::iterator it=pos[t].begin(); it!=pos[t].end(); ++it)
+        {
+            it->second = static_cast<int>(core_.size());
+            core_.push_back(getCoreEntry(core,t,it->first.first,it->first.second));
+        }
+    }
+
+    // node values, entries of one position combined in node order
+    int ndata = static_cast<int>(data.size());
+    values_.resize(ndata);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads) if(numThreads > 1)
+#endif
+    {
+        vector<SmiNodeEntry> nodeEntries;
+        // position and index of every entry
+        vector<pair<int,int> > order;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,16)
+#endif
+        for (int k=0; k<ndata; ++k)
+        {
+            SmiNodeData *node = data[k];
+            SmiCoreCombineRule *rule = node->getCoreCombineRule();
+            SmiEntryMap &stagePos = pos[node->getStage()];
+            getNodeEntries(node,nodeEntries);
+            order.resize(nodeEntries.size());
+            for (unsigned int e=0; e<nodeEntries.size(); ++e)
+                order[e] = make_pair(stagePos.find(make_pair(nodeEntries[e].i,nodeEntries[e].j))->second,
+                    static_cast<int>(e));
+            sort(order.begin(),order.end());
+
+            vector<SmiNodeValue> &v = values_[k];
+            for (unsigned int e=0; e<order.size(); ++e)
+            {
+                if (v.empty() || v.back().pos != order[e].first)
+                {
+                    SmiNodeValue nv = { order[e].first, core_[order[e].first] };
+                    v.push_back(nv);
+                }
+                SmiNodeEntry &entry = nodeEntries[order[e].second];
+                if (rule)
+                    rule->Process(&v.back().value,entry.j,1,&entry.j,&entry.value);
+                else
+                    v.back().value = entry.value;
+            }
+        }
+    }
+}
+
+double
+SmiScnNodeDistance::distance(int i, int j)
+{
+    const int *pi = &path_[static_cast<size_t>(i)*nstages_];
+    const int *pj = &path_[static_cast<size_t>(j)*nstages_];
+    double d = 0.0;
+    for (int t=0; t<nstages_; ++t)
+        if (pi[t] != pj[t])
+            d += nodeDistance(pi[t],pj[t]);
+    return d;
+}
+
+double
+SmiScnNodeDistance::nodeDistance(int u, int v)
+{
+    // core data (-1) has no entries
+    int na = u < 0 ? 0 : static_cast<int>(values_[u].size());
+    int nb = v < 0 ? 0 : static_cast<int>(values_[v].size());
+    const SmiNodeValue *a = na ? &values_[u][0] : NULL;
+    const SmiNodeValue *b = nb ? &values_[v][0] : NULL;
+    double d = 0.0;
+    int ia = 0, ib = 0;
+    while (ia < na || ib < nb)
+    {
+        if (ib == nb || (ia < na && a[ia].pos < b[ib].pos))
+        {
+            d += fabs(a[ia].value-core_[a[ia].pos]);
+            ia++;
+        }
+        else if (ia == na || b[ib].pos < a[ia].pos)
+        {
+            d += fabs(b[ib].value-core_[b[ib].pos]);
+            ib++;
+        }
+        else
+        {
+            d += fabs(a[ia].value-b[ib].value);
+            ia++;
+            ib++;
+        }
+    }
+    return d;
+}
+}
+
+double
+SmiScnModel::reduceTree(int numScenarios, double tolerance, SmiScenarioReduction::Method method)
+{
+    int nscen = getNumScenarios();
+    if (nscen <= 1)
+        return 0.0;
+
+    vector<double> prob(nscen);
+    for (int s=0; s<nscen; ++s)
+        prob[s] = getLeafNode(s)->getProb()/totalProb_;
+    SmiScnNodeDistance dist(this,numThreads_);
+
+    SmiScenarioReduction reduction(nscen,&prob[0],&dist,numThreads_);
+    double d = reduction.reduce(method,numScenarios,tolerance);
+
+    const vector<double> &newProb = reduction.getProbabilities();
+    for (int s=0; s<nscen; ++s)
+        prob[s] = newProb[s]*totalProb_;
+    keepScenarios(reduction.getKept(),prob);
+    return d;
+}
+
+void
+SmiScnModel::keepScenarios(const vector<int> &kept, const vector<double> &prob)
+{
+    SmiCoreData *core = getRootNode()->getNode()->getCore();
+    int nstages = core->getNumStages();
+    vector<SmiScnNode *> &nodes = smiTree_.wholeTree();
+
+    // scenario of the new tree that adds each kept node, by node index
+    vector<int> newScen(nodes.size(),-1);
+    SmiScenarioTree<SmiScnNode *> tree;
+    vector<SmiScnNode *> pathdata;
+    for (unsigned int k=0; k<kept.size(); ++k)
+    {
+        int s = kept[k];
+        int depth = smiTree_.getLeaf(s)->depth();
+        // the path is in the new tree down to stage b
+        int b = -1;
+        pathdata.resize(depth+1);
+        for (int t=0; t<=depth; ++t)
+        {
+            SmiTreeNode<SmiScnNode *> *n = smiTree_.find(s,t);
+            pathdata[t] = n->getDataPtr();
+            pathdata[t]->setProb(0.0);
+            if (newScen[n->index()] >= 0)
+                b = t;
+        }
+        int ns;
+        if (b < 0)
+            ns = tree.addPathtoLeaf(0,0,pathdata);
+        else
+            ns = tree.addPathtoLeaf(newScen[smiTree_.find(s,b)->index()],b,pathdata,b+1);
+        for (int t=b+1; t<=depth; ++t)
+        {
+            newScen[smiTree_.find(s,t)->index()] = ns;
+            pathdata[t]->setScenarioIndex(ns);
+        }
+    }
+
+    // probabilities of the kept paths
+    for (unsigned int k=0; k<kept.size(); ++k)
+    {
+        int s = kept[k];
+        for (SmiTreeNode<SmiScnNode *> *n=smiTree_.getLeaf(s); n; n=n->getParent())
+            n->getDataPtr()->addProb(prob[s]);
+    }
+
+    for (unsigned int k=0; k<nodes.size(); ++k)
+        if (newScen[k] < 0)
+            deleteNode(nodes[k]);
+    smiTree_.swap(tree);
+
+    // sizes of the det. eq., as generateScenario counts them
+    ncol_ = nrow_ = nels_ = nqels_ = 0;
+    std::fill_n(maxNelsPerScenInStage, nstages, 0);
+    vector<SmiScnNode *> &keptNodes = smiTree_.wholeTree();
+    for (unsigned int k=0; k<keptNodes.size(); ++k)
+    {
+        SmiNodeData *node = keptNodes[k]->getNode();
+        int t = node->getStage();
+        SmiNodeData *cnode = core->getNode(t);
+        int nels = cnode->getNumMatrixElements();
+        if (node != cnode)
+            nels += node->getNumMatrixElements();
+        ncol_ += core->getNumCols(t);
+        nrow_ += core->getNumRows(t);
+        nels_ += nels;
+        maxNelsPerScenInStage[t] = max(maxNelsPerScenInStage[t],nels);
+        if (cnode->hasQdata())
+            nqels_ += cnode->getQdata()->getNumEls();
+    }
+    numNodesLoaded_ = 0;
+}
+
+void
+SmiScnModel::updateScenarioSolver(OsiSolverInterface *osi, vector<SmiScnNode *> &loaded, vector<SmiScnNode *> &path,
+    double *clo, double *cup, double *obj, double *rlo, double *rup, double *denseRow, double *dwork, int *iwork)
+{
+    SmiCoreData *core = this->core_;
+    int ncol = core->getNumCols();
+    int nrow = core->getNumRows();
+    double *wclo = dwork;
+    double *wcup = wclo+ncol;
+    double *wobj = wcup+ncol;
+    double *wrlo = wobj+ncol;
+    double *wrup = wrlo+nrow;
+    double *odels = wrup+nrow;
+    double *ndels = odels+ncol+1;
+    int *oindx = iwork;
+    int *nindx = oindx+ncol+1;
+
+    for (unsigned int t = 0; t < path.size(); ++t)
+    {
+        // nodes shared with the loaded scenario need nothing
+        if (path[t] == loaded[t])
+            continue;
+        SmiNodeData *onode = loaded[t]->getNode();
+        SmiNodeData *nnode = path[t]->getNode();
+        int stg = nnode->getStage();
+        int coff = core->getColStart(stg);
+        int roff = core->getRowStart(stg);
+
+        // bounds and objective of the stage block
+        nnode->copyColLower(wclo);
+        nnode->copyColUpper(wcup);
+        nnode->copyObjective(wobj);
+        for (int j = 0; j < core->getNumCols(stg); ++j)
+        {
+            if (wclo[j] != clo[coff+j] || wcup[j] != cup[coff+j])
+            {
+                clo[coff+j] = wclo[j];
+                cup[coff+j] = wcup[j];
+                osi->setColBounds(coff+j,wclo[j],wcup[j]);
+            }
+            if (wobj[j] != obj[coff+j])
+            {
+                obj[coff+j] = wobj[j];
+                osi->setObjCoeff(coff+j,wobj[j]);
+            }
+        }
+        nnode->copyRowLower(wrlo);
+        nnode->copyRowUpper(wrup);
+        for (int i = 0; i < core->getNumRows(stg); ++i)
+        {
+            if (wrlo[i] != rlo[roff+i] || wrup[i] != rup[roff+i])
+            {
+                rlo[roff+i] = wrlo[i];
+                rup[roff+i] = wrup[i];
+                osi->setRowBounds(roff+i,wrlo[i],wrup[i]);
+            }
+        }
+
+        // matrix: only rows with stochastic entries in either node can differ;
+        // columns and rows keep their core positions
+        if (!stg)
+            continue;
+        SmiNodeData *cnode = core->getNode(stg);
+        for (int i = roff; i < core->getRowStart(stg+1); ++i)
+        {
+            if (!onode->getRowLength(i) && !nnode->getRowLength(i))
+                continue;
+            int olen, nlen;
+            if (onode->getRowLength(i))
+                olen = combineNodeRow(onode,i,odels,oindx,denseRow);
+            else
+            {
+                olen = cnode->getRowLength(i);
+                memcpy(odels,cnode->getRowElements(i),sizeof(double)*olen);
+                memcpy(oindx,cnode->getRowIndices(i),sizeof(int)*olen);
+            }
+            if (nnode->getRowLength(i))
+                nlen = combineNodeRow(nnode,i,ndels,nindx,denseRow);
+            else
+            {
+                nlen = cnode->getRowLength(i);
+                memcpy(ndels,cnode->getRowElements(i),sizeof(double)*nlen);
+                memcpy(nindx,cnode->getRowIndices(i),sizeof(int)*nlen);
+            }
 
+            // merge-join of the two sorted rows; a dropped entry is set to zero
+            int a = 0, b = 0;
+            while (a < olen || b < nlen)
+            {
+                if (b == nlen || (a < olen && oindx[a] < nindx[b]))
+                {
+                    osi->modifyCoefficient(i,oindx[a],0.0);
+                    a++;
+                }
+                else if (a == olen || nindx[b] < oindx[a])
+                {
+                    osi->modifyCoefficient(i,nindx[b],ndels[b]);
+                    b++;
+                }
+                else
+                {
+                    if (odels[a] != ndels[b])
+                        osi->modifyCoefficient(i,nindx[b],ndels[b]);
+                    a++;
+                    b++;
+                }
+            }
+        }
+    }
+    loaded = path;
+}
+
+void
+SmiScnModel::generateColumnOrderedArrays(vector<SmiScnNode *> &nodes, vector<bool> &included)
+{
+    int nnodes = static_cast<int>(nodes.size());
+    SmiCoreData *core = nnodes ? nodes[0]->getNode()->getCore() : NULL;
+    int nstages = core ? core->getNumStages() : 0;
+
+    // work arrays: core stage block and stochastic entries of a node
+    int maxWork=0;
+    for (int k=0; k<nnodes; ++k)
+    {
+        if (!included[k])
+            continue;
+        SmiNodeData *node = nodes[k]->getNode();
+        maxWork = max(maxWork,node->getCore()->getNumCols()+node->getNumMatrixElements());
+    }
+
+    // tree nodes sharing node data have the same stochastic rows:
+    // their column counts are taken once, at the first node holding the data
+    vector<int> firstUse(nnodes);
+    std::map<SmiNodeData *,int> dataUse;
+    for (int k=0; k<nnodes; ++k)
+        firstUse[k] = included[k] ? dataUse.insert(std::make_pair(nodes[k]->getNode(),k)).first->second : k;
+
+    // A column of a node at stage t has elements in the rows of the node
+    // and of its descendants. descStart/desc list, for every node, the
+    // included nodes of its subtree in tree order, so in increasing rows.
+    std::map<SmiScnNode *,int> nodeIndex;
+    for (int k=0; k<nnodes; ++k)
+        nodeIndex[nodes[k]] = k;
+    vector<int> parent(nnodes,-1);
+    for (int k=0; k<nnodes; ++k)
+        if (nodes[k]->getParent())
+            parent[k] = nodeIndex[nodes[k]->getParent()];
+    vector<int> descStart(nnodes+1,0);
+    for (int k=0; k<nnodes; ++k)
+        if (included[k])
+            for (int p=k; p>=0; p=parent[p])
+                descStart[p+1]++;
+    for (int k=0; k<nnodes; ++k)
+        descStart[k+1] += descStart[k];
+    vector<int> desc(descStart[nnodes]);
+    vector<int> dpos(descStart.begin(),descStart.end()-1);
+    for (int k=0; k<nnodes; ++k)
+        if (included[k])
+            for (int p=k; p>=0; p=parent[p])
+                desc[dpos[p]++] = k;
+
+    // core column counts of the rows of every stage, over the columns of
+    // the stage and of the stages before it
+    vector<vector<int> > coreCount(nstages);
+    for (int s=0; s<nstages; ++s)
+    {
+        SmiNodeData *cnode = core->getNode(s);
+        coreCount[s].assign(core->getColStart(s+1),0);
+        for (int i=core->getRowStart(s); i<core->getRowStart(s+1); ++i)
+        {
+            const int *cind = cnode->getRowIndices(i);
+            for (int e=0; e<cnode->getRowLength(i); ++e)
+                coreCount[s][cind[e]]++;
+        }
+    }
+
+    // changes of these counts by the merged stochastic rows of every node data
+    vector<vector<std::pair<int,int> > > delta(nnodes);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads_) if(numThreads_ > 1)
+#endif
+    {
+        double *wdels = new double[maxWork+1];
+        int *windx = new int[maxWork+1];
+        // dense work row -- getDenseRow(i) is not thread safe
+        double *denseRow = numThreads_ > 1 ? new double[maxWork+1] : NULL;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,16)
+#endif
+        for (int k=0; k<nnodes; ++k)
+        {
+            if (!included[k] || firstUse[k]!=k)
+                continue;
+            countColumnDeltas(nodes[k],wdels,windx,denseRow,delta[k]);
+        }
+        delete [] wdels;
+        delete [] windx;
+        delete [] denseRow;
+    }
+
+    // Column pass: every node counts its own columns from the core counts
+    // and the deltas of its subtree
+    int *cstrt = new int[ncol_+1];
+    cstrt[0] = 0;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(numThreads_) schedule(dynamic,16) if(numThreads_ > 1)
+#endif
+    for (int k=0; k<nnodes; ++k)
+    {
+        int t = nodes[k]->getStage();
+        int jlo = core->getColStart(t);
+        int jhi = core->getColStart(t+1);
+        int *clen = cstrt+1+nodes[k]->getColStart()-jlo;
+        for (int j=jlo; j<jhi; ++j)
+            clen[j] = 0;
+        for (int d=descStart[k]; d<descStart[k+1]; ++d)
+        {
+            int n = desc[d];
+            const vector<int> &count = coreCount[nodes[n]->getStage()];
+            for (int j=jlo; j<jhi; ++j)
+                clen[j] += count[j];
+            const vector<std::pair<int,int> > &dn = delta[firstUse[n]];
+            for (unsigned int e=0; e<dn.size() && dn[e].first<jhi; ++e)
+                if (dn[e].first>=jlo)
+                    clen[dn[e].first] += dn[e].second;
+        }
+    }
+    for (int j=0; j<ncol_; ++j)
+        cstrt[j+1] += cstrt[j];
+    this->nels_max = cstrt[ncol_];
+
+    // quadratic element offsets of the nodes
+    vector<int> qelsStart(nnodes+1);
+    qelsStart[0]=0;
+    for (int k=0; k<nnodes; ++k)
+    {
+        qelsStart[k+1] = qelsStart[k];
+        if (!included[k])
+            continue;
+        SmiNodeData *cnode = core->getNode(nodes[k]->getStage());
+        if (cnode->hasQdata())
+            qelsStart[k+1] += cnode->getQdata()->getNumEls();
+    }
+
+    // all det. eq. arrays are allocated once, with their exact sizes
+    this->dclo_ = new double[this->ncol_];
+    this->dcup_ = new double[this->ncol_];
+    this->dobj_ = new double[this->ncol_];
+    this->drlo_ = new double[this->nrow_];
+    this->drup_ = new double[this->nrow_];
+    this->dels_ = new double[this->nels_max];
+    this->indx_ = new int[this->nels_max];
+    this->rstrt_ = NULL;
+
+    this->nqels_ = qelsStart[nnodes];
+	if (this->nqels_)
+	{
+		this->qdels_= new double[this->nqels_];
+		this->qindx_= new int[this->nqels_];
+		this->qstart_= new int[this->ncol_+1];
+		memset(this->qstart_,0,(this->ncol_+1)*sizeof(int));
+	}
+
+    // Fill pass: every node fills its own columns, going through the rows
+    // of its subtree in order, so row indices increase in every column
+    vector<int> cpos(cstrt,cstrt+ncol_+1);
+#ifdef _OPENMP
+#pragma omp parallel num_threads(numThreads_) if(numThreads_ > 1)
+#endif
+    {
+        double *wdels = new double[maxWork+1];
+        int *windx = new int[maxWork+1];
+        double *denseRow = numThreads_ > 1 ? new double[maxWork+1] : NULL;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic,16)
+#endif
+        for (int k=0; k<nnodes; ++k)
+        {
+            if (included[k])
+                fillNodeVectors(nodes[k],qelsStart[k]);
+            int t = nodes[k]->getStage();
+            int jlo = core->getColStart(t);
+            int jhi = core->getColStart(t+1);
+            int *kpos = &cpos[0]+nodes[k]->getColStart()-jlo;
+            for (int d=descStart[k]; d<descStart[k+1]; ++d)
+                fillNodeColumns(nodes[desc[d]],jlo,jhi,kpos,wdels,windx,denseRow);
+        }
+        delete [] wdels;
+        delete [] windx;
+        delete [] denseRow;
+    }
+
+    // sanity check: the column counts were exact
+    for (int j=0; j<ncol_; ++j)
+        assert(cpos[j] == cstrt[j+1]);
+    nels_ = this->nels_max;
+
+    matrix_ = new CoinPackedMatrix(true,0,0);
+    int *len=NULL;
+    matrix_->assignMatrix(true,nrow_,ncol_,nels_,
+        dels_,indx_,cstrt,len);
+}
+
+void
+SmiScnModel::countColumnDeltas(SmiScnNode *tnode, double *wdels, int *windx, double *denseRow,
+    vector<std::pair<int,int> > &delta)
+{
+    SmiNodeData *node = tnode->getNode();
+    SmiCoreData *core = node->getCore();
+    int stg = node->getStage();
+    SmiNodeData *cnode = core->getNode(stg);
+
+    delta.clear();
+    // rows without stochastic entries are copied from the core
+    if (!stg || !node->getNumMatrixElements())
+        return;
+
+    for (int i=core->getRowStart(stg); i<core->getRowStart(stg+1) ; i++)
+    {
+        if (!node->getRowLength(i))
+            continue;
+        // the merged row replaces the core row
+        int len = combineNodeRow(node,i,wdels,windx,denseRow);
+        for (int e=0; e<len; ++e)
+            delta.push_back(std::make_pair(windx[e],1));
+        const int *cind = cnode->getRowIndices(i);
+        for (int e=0; e<cnode->getRowLength(i); ++e)
+            delta.push_back(std::make_pair(cind[e],-1));
+    }
+
+    // one entry per column whose count changes, in column order
+    sort(delta.begin(),delta.end());
+    unsigned int n=0;
+    for (unsigned int e=0; e<delta.size(); )
+    {
+        int j = delta[e].first;
+        int d = 0;
+        for (; e<delta.size() && delta[e].first==j; ++e)
+            d += delta[e].second;
+        if (d)
+            delta[n++] = std::make_pair(j,d);
+    }
+    delta.resize(n);
+}
+
+void
+SmiScnModel::fillNodeColumns(SmiScnNode *tnode, int jlo, int jhi, int *cpos, double *wdels, int *windx, double *denseRow)
+{
+    SmiNodeData *node = tnode->getNode();
+    SmiCoreData *core = node->getCore();
+    int stg = node->getStage();
+    SmiNodeData *cnode = core->getNode(stg);
+
+    int row = tnode->getRowStart();
+    for (int i=core->getRowStart(stg); i<core->getRowStart(stg+1) ; i++, row++)
+    {
+        const double *els;
+        const int *ind;
+        int len;
+        if (stg && node->getRowLength(i))
+        {
+            len = combineNodeRow(node,i,wdels,windx,denseRow);
+            els = wdels;
+            ind = windx;
+        }
+        else
+        {
+            els = cnode->getRowElements(i);
+            ind = cnode->getRowIndices(i);
+            len = cnode->getRowLength(i);
+        }
+        for (int e=0; e<len; ++e)
+        {
+            if (ind[e]<jlo || ind[e]>=jhi)
+                continue;
+            int pos = cpos[ind[e]]++;
+            dels_[pos] = els[e];
+            indx_[pos] = row;
+        }
+    }
+}
+
+int
+SmiScnModel::countNodeElements(SmiScnNode *tnode, double *wdels, int *windx, double *denseRow)
+{
+    SmiNodeData *node = tnode->getNode();
+    SmiCoreData *core = node->getCore();
+    int stg = node->getStage();
+    SmiNodeData *cnode = core->getNode(stg);
+
+    // rows without stochastic entries are copied from the core
+    if (!stg || !node->getNumMatrixElements())
+        return cnode->getNumMatrixElements();
+
+    int nels=0;
+    for (int i=core->getRowStart(stg); i<core->getRowStart(stg+1) ; i++)
+    {
+        if (node->getRowLength(i))
+        {
+            // combine into the work arrays, as fillNode does
+            nels += combineNodeRow(node,i,wdels,windx,denseRow);
+        }
+        else
+            nels += cnode->getRowLength(i);
+    }
+    return nels;
+}
+
+int
+SmiScnModel::combineNodeRow(SmiNodeData *node, int i, double *dels, int *indx, double *denseRow)
+{
+    // merge the sorted core row with the sorted stochastic row
+    int rowNumEls=node->combineWithCoreRow(i,dels,indx);
+
+    // combine rule without a sparse path: go through a dense copy of the core row
+    if (rowNumEls<0)
+    {
+        // the caller may supply its own work array, which is needed when nodes are filled concurrently
+        SmiNodeData *cnode = node->getCore()->getNode(node->getStage());
+        double *denseCoreRow = denseRow ? cnode->getDenseRow(i,denseRow) : cnode->getDenseRow(i);
+        rowNumEls=node->combineWithDenseCoreRow(denseCoreRow,node->getRowLength(i),node->getRowIndices(i),node->getRowElements(i),dels,indx);
+    }
+    return rowNumEls;
+}
+
+void
+SmiScnModel::reserveNodeMaps(int ncol, int nrow)
+{
+    if (ncol > columnNodeCap)
+    {
+        this->columnNode = (int *)realloc(this->columnNode,sizeof(int)*ncol);
+        columnNodeCap = ncol;
+    }
+    if (nrow > rowNodeCap)
+    {
+        this->rowNode = (int *)realloc(this->rowNode,sizeof(int)*nrow);
+        rowNodeCap = nrow;
+    }
 }
 
 void
@@ -1225,13 +2430,7 @@ double SmiScnModel::getColValue(const double *osiSoln,int ns, int stage, int col
     assert( ns < this->getNumScenarios() );
     assert( stage < this->core_->getNumStages() );
 
-    SmiScnNode *node = this->getLeafNode(ns);
-    int curStage = this->core_->getNumStages() - stage-1; // Number of stages
-    while (node != NULL && curStage){ // Go to the correct node. If Stage is reduced to zero we are at the correct node.
-        // get parent of node
-        node = node->getParent();
-        --curStage;
-    }
+    SmiScnNode *node = smiTree_.find(ns,stage)->getDataPtr();
 
     assert( colIndex < core_->getColStart(stage)+node->getNumCols() && colIndex >= core_->getColStart(stage));
     return osiSoln[node->getColStart()+colIndex-core_->getColStart(stage)];// Return element in matrix that is at nodeColStart + colIndex for stage. Where to get colIndex for stage?
@@ -1310,14 +2509,7 @@ double SmiScnModel::getRowValue(const double *osiSoln, int ns, int stage, int ro
 {
     assert( ns < this->getNumScenarios() );
     assert( stage < this->core_->getNumStages() );
-    // start with leaf node
-    SmiScnNode *node = this->getLeafNode(ns);
-    int curStage = this->core_->getNumStages() - stage-1; // Number of stages
-    while (node != NULL && curStage){ // Go to the correct node. If Stage is reduced to zero we are at the correct node.
-        // get parent of node
-        node = node->getParent();
-        --curStage;
-    }
+    SmiScnNode *node = smiTree_.find(ns,stage)->getDataPtr();
 
     assert( rowIndex < core_->getRowStart(stage)+node->getNumRows() && rowIndex >= core_->getRowStart(stage));
 	double dvalue = osiSoln[node->getRowStart()+rowIndex-core_->getRowStart(stage)];
@@ -8,6 +8,7 @@
 #include "CoinPragma.hpp"
 #include "SmiDiscreteDistribution.hpp"
 #include "SmiScenarioTree.hpp"
+#include "SmiScenarioReduction.hpp"
 #include "SmiScnData.hpp"
 #include "OsiSolverInterface.hpp"
 #include "CoinPackedVector.hpp"
@@ -17,6 +18,7 @@
 
 // STL declarations
 #include <vector>
+#include <map>
 
 // forward declaration of SmiScnNode
 class SmiScnNode;
@@ -152,6 +154,23 @@ public:
         std::vector<int>labels, double prob,
         SmiCoreCombineRule *r = SmiCoreCombineReplace::Instance());
 
+    /** generate scenario from matrix triplets
+
+    As generateScenario above, with the matrix entries given as numTriplets
+    (row, column, element) triplets in core indices instead of a matrix
+    of the size of the core. Triplets are bucketed by the stage of their
+    row and each node only looks at its own, so the work is proportional
+    to the number of triplets. Of repeated entries the last one counts.
+
+    */
+    SmiScenarioIndex generateScenario(SmiCoreData *core,
+        int numTriplets, const int *rows, const int *cols, const double *els,
+        CoinPackedVector *dclo, CoinPackedVector *dcup,
+        CoinPackedVector *dobj,
+        CoinPackedVector *drlo, CoinPackedVector *drup,
+        SmiStageIndex branch, SmiScenarioIndex anc, double prob,
+        SmiCoreCombineRule *r = SmiCoreCombineReplace::Instance());
+
 	    /** generate scenario with ancestor/branch node identification
 
     Core argument must be supplied.
@@ -217,16 +236,212 @@ public:
 
     */
     OsiSolverInterface * loadOsiSolverData();
+
+    /** Loads the det. eq. of a subtree into the osi.
+
+    The subtree is rooted at the node of scenario scenStart at the given
+    stage. Its ancestors are loaded as virtual nodes: their columns are
+    there (with their bounds and zero cost) since the subtree rows refer
+    to them, but none of their rows are. Fix or price these columns to
+    get a decomposition subproblem.
+
+    Objective coefficients are those of the full det. eq., so the
+    objectives of a partition of the tree add up to the full objective.
+    Only the subtree and its ancestors are visited.
+    */
     OsiSolverInterface * loadOsiSolverDataForSubproblem(int stage, int scenStart);
 
+    /** Loads the det. eq. of the scenarios scenStart,...,scenEnd-1
+    into the osi, from the given stage on; earlier nodes of these
+    scenarios are virtual, as above.
+    */
+    OsiSolverInterface * loadOsiSolverDataForSubproblem(int stage, int scenStart, int scenEnd);
+
+    /** Appends scenarios generated since the last loadOsiSolverData.
+
+    Only the columns and rows of the new nodes are passed to the solver,
+    via addCols/addRows. Objective coefficients of nodes already in the
+    solver are rescaled to the new total probability, and the current
+    basis is kept (new rows basic, new columns at lower bound) so the
+    next resolve() starts warm.
+
+    Falls back to loadOsiSolverData if nothing has been loaded yet,
+    or if the model has quadratic data.
+    */
+    OsiSolverInterface * appendScenariosToOsi();
+
+    /** Refreshes bounds, right hand sides and objective in the solver.
+
+    Use this after changing values of scenario data (see the
+    SmiNodeData::getMutable...Elements covers) or node probabilities,
+    when the matrix is unchanged. Every loaded node is recombined with
+    the core and only entries that differ from the loaded values are
+    passed to the solver, using setColBounds, setObjCoeff and setRowBounds
+    at the node offsets. The basis is left alone, so the next resolve()
+    starts warm. Scenarios generated since the last load are appended
+    as in appendScenariosToOsi.
+
+    Returns the number of entries changed in the solver.
+    */
+    int updateOsiSolverData();
+
+    /** Wait-and-See: solves every scenario problem on its own.
+
+    Returns (objective value, probability) of every scenario, in
+    scenario order. Scenarios are solved by getNumThreads() workers,
+    each with its own clone of osiSolver and its own arrays; the
+    model's det. eq. and solver are left untouched.
+    */
     std::vector< std::pair<double,double> > solveWS(OsiSolverInterface *osiSolver, double objSense); //Returns value of Wait-And-See solution, with objSense of 1 (= minimization) for default
     std::pair<double,double*> solveEV(OsiSolverInterface *osiSolver, double objSense);
+    /// Expected result of the EV solution; the scenario problems are solved as in solveWS
     double solveEEV(OsiSolverInterface *osiSolver, double objSense);
 
+    /** Warm-started scenario solves in solveWS and solveEEV.
+
+    With setWarmStartScenarios(true) a worker loads its first scenario
+    only. For every later scenario the stage blocks of the nodes that
+    differ from the loaded ones are recombined, the differences go to
+    the solver through setColBounds, setObjCoeff, setRowBounds and
+    modifyCoefficient, and the problem is resolved from the previous
+    basis. Default is off: every scenario is loaded and solved from
+    scratch.
+    */
+    //@{
+    void setWarmStartScenarios(bool b) { warmScenarios_ = b; }
+    bool getWarmStartScenarios() { return warmScenarios_; }
+    //@}
+
     double getWSValue(OsiSolverInterface *osiSolver, double objSense);
     double getEVValue(OsiSolverInterface* osiSolver, double objSense);
     double getEEVValue(OsiSolverInterface* osiSolver, double objSense);
 
+    /**@name Parallel generation of the deterministic equivalent
+
+    loadOsiSolverData builds the deterministic equivalent in three passes:
+    a serial pass assigns each tree node its row and column offsets, a
+    counting pass gives the exact number of elements of each node, and a
+    fill pass writes each node into its own slice of the row-ordered
+    arrays. With more than one thread the counting and fill passes run
+    in parallel; the arrays are identical to the ones of the serial build.
+
+    Threads are provided by OpenMP. If Smi is compiled without OpenMP
+    everything runs on the calling thread.
+    */
+    //@{
+    void setNumThreads(int n) { numThreads_ = n; }
+    int getNumThreads() { return numThreads_; }
+    //@}
+
+    /**@name Hand-off of the deterministic equivalent to the solver
+
+    By default loadOsiSolverData copies the generated arrays into the
+    solver and SmiScnModel keeps its own copy. With setAssignSolverData(true)
+    the arrays are handed over with OsiSolverInterface::assignProblem and
+    no copy is kept, which halves peak memory for large models. Only the
+    node offsets needed by the solution queries (getColSolution etc.) remain;
+    appendScenariosToOsi and updateOsiSolverData work from the solver's data.
+    */
+    //@{
+    void setAssignSolverData(bool b) { assignSolverData_ = b; }
+    bool getAssignSolverData() { return assignSolverData_; }
+    //@}
+
+    /**@name Column-ordered generation of the deterministic equivalent
+
+    Simplex solvers such as Clp store the matrix by column. With
+    setColumnOrdered(true) the deterministic equivalent is generated
+    directly in column-major order, so the solver does not have to
+    transpose the matrix on load. Column lengths are counted up front
+    from the core rows of every stage and the stochastic rows of every
+    node data; then every node fills its own columns from the rows of its
+    subtree. Both passes run on getNumThreads() threads, and no row-ordered
+    copy of the matrix is built. Rows of a node are read once for every
+    stage whose columns they reach.
+    */
+    //@{
+    void setColumnOrdered(bool b) { colOrdered_ = b; }
+    bool getColumnOrdered() { return colOrdered_; }
+    //@}
+
+    /**@name Sharing of equal node data
+
+    Scenario generators often produce many tree nodes with the same
+    stochastic data, e.g. a stage whose distribution does not depend on
+    the branch taken. With setShareNodeData(true) generateScenario looks
+    up every new node in a table keyed by a hash of its stage and packed
+    data arrays; a node equal to one already in the tree is dropped and
+    the tree node refers to the existing instance, which is reference
+    counted. When the deterministic equivalent is built the elements of
+    shared node data are counted once. Only scenarios generated after the
+    call are shared. Node data entered in the table is read only: its
+    SmiNodeData::getMutable... covers return NULL.
+    */
+    //@{
+    void setShareNodeData(bool b) { shareNodeData_ = b; }
+    bool getShareNodeData() { return shareNodeData_; }
+    //@}
+
+    /** Arena holding the arrays of the node data generated by this model.
+        They are freed in one go when the model and every submodel sharing
+        its nodes are gone. */
+    SmiNodeDataArena *getNodeDataArena() { return nodeArena_; }
+
+    /**@name Scenario problems
+
+    The problem of a single scenario has the dimensions of the core:
+    every column and row is at its core position and the objective is
+    not weighted by probability. These methods only read the tree, so
+    scenarios can be filled concurrently; decomposition solvers use them
+    to build their subproblems.
+    */
+    //@{
+    /** Writes the problem of scenario scen into the given arrays; returns
+    the number of matrix elements. clo..obj hold core getNumCols(),
+    rlo, rup core getNumRows() and rstrt core getNumRows()+1 entries;
+    dels and indx are grown as needed; denseRow (core getNumCols()+1
+    entries) is work space. */
+    int fillScenarioArrays(int scen, double *clo, double *cup, double *obj, double *rlo, double *rup,
+        std::vector<double> &dels, std::vector<int> &indx, int *rstrt, double *denseRow);
+    /** Writes the stage block of tnode: its columns and rows, each from
+    position 0, with column indices at their core positions (columns of
+    earlier stages are the ancestors'); returns the number of matrix
+    elements. clo..obj hold the stage's getNumCols(), rlo, rup the
+    stage's getNumRows() and rstrt getNumRows()+1 entries; the rest is
+    as in fillScenarioArrays. Nested decomposition solvers use this to
+    build the problem of one tree node. */
+    int fillNodeArrays(SmiScnNode *tnode, double *clo, double *cup, double *obj, double *rlo, double *rup,
+        std::vector<double> &dels, std::vector<int> &indx, int *rstrt, double *denseRow);
+    /// Nodes of scenario scen, root first; thread safe, unlike smiTree_.getScenario
+    void getScenarioNodes(int scen, std::vector<SmiScnNode *> &path);
+    //@}
+
+    /**@name Scenario reduction
+
+    Replaces the scenarios by a subset chosen with SmiScenarioReduction;
+    the probability of every removed scenario goes to the nearest kept
+    one. The distance between two scenarios is the l1 distance of their
+    stochastic data: every bound, objective, rhs and matrix entry that is
+    stochastic in some node of its stage, combined with the core.
+    Distances are computed when the reduction needs them, from the node
+    data, on getNumThreads() threads; no distance matrix is stored, so
+    memory grows with the number of scenarios, not its square. Time does:
+    ForwardSelection evaluates O(n^2) distances per kept scenario.
+
+    The tree is rebuilt from the paths of the kept scenarios, which keep
+    their order but get new indices; child labels are not kept. Load the
+    deterministic equivalent again afterwards. Both methods return the
+    Kantorovich distance of the reduction, for probabilities scaled to 1.
+    */
+    //@{
+    /// keeps numScenarios scenarios
+    double reduceScenarios(int numScenarios,
+        SmiScenarioReduction::Method method = SmiScenarioReduction::ForwardSelection);
+    /// keeps as few scenarios as the heuristic finds within tolerance
+    double reduceScenariosToTolerance(double tolerance,
+        SmiScenarioReduction::Method method = SmiScenarioReduction::BackwardReduction);
+    //@}
+
     //Let SmiScnModel own core data
     void setCore(SmiCoreData * val) { core_ = val; }
 
@@ -288,12 +503,15 @@ public:
     handler_(NULL),messages_(NULL),osiStoch_(NULL), nrow_(0), ncol_(0), nels_(0),nels_max(0),
         drlo_(NULL), drup_(NULL), dobj_(NULL), dclo_(NULL), dcup_(NULL), matrix_(NULL),
         dels_(NULL),indx_(NULL),rstrt_(NULL),minrow_(0),
-        solve_synch_(false),totalProb_(0),core_(NULL),smiTree_(),integerInd(NULL),integerLen(0),binaryInd(NULL),binaryLen(0),intIndices(),maxNelsPerScenInStage(NULL)
+        solve_synch_(false),totalProb_(0),core_(NULL),smiTree_(),integerInd(NULL),integerLen(0),binaryInd(NULL),binaryLen(0),intIndices(),maxNelsPerScenInStage(NULL),numThreads_(1),numNodesLoaded_(0),assignSolverData_(false),colOrdered_(false),warmScenarios_(false),shareNodeData_(false),nodeDataTable_(),nodeArena_(new SmiNodeDataArena())
     {
+		nodeArena_->addRef();
 		nqels_=0;
 		numNodes =0;
 		columnNode = NULL;
 		rowNode = NULL;
+		columnNodeCap = 0;
+		rowNodeCap = 0;
 	}
 
     // destructor
@@ -345,6 +563,8 @@ private:
 	int *columnNode;
 	int *rowNode;
 	int numNodes;
+	int columnNodeCap;
+	int rowNodeCap;
 
 public:
 	int getColumnNode(int colIndex) { return columnNode[colIndex]; }
@@ -356,6 +576,54 @@ private:
 	///constructs LP and QP data arrays for Deterministic Equivalent
 	void generateSolverArrays();
 
+	///sets offsets and bookkeeping of a node; returns false for virtual nodes
+	bool placeNode(SmiScnNode *tnode, bool notDetEq);
+	///copies data of a placed node into the solver arrays; returns number of matrix elements
+	int fillNode(SmiScnNode *tnode, int nelsStart, int nqelsStart, double *denseRow);
+	///copies bounds, objective and quadratic data of a placed node into the solver arrays
+	void fillNodeVectors(SmiScnNode *tnode, int nqelsStart);
+	///writes the rows of a placed node into dels/indx, with row starts rstrt[1..] offset by base;
+	///with coreCols the columns keep their core positions, as in a single scenario problem
+	int fillNodeRows(SmiScnNode *tnode, double *dels, int *indx, int *rstrt, int base, double *denseRow, bool coreCols=false);
+	///changes the scenario problem of the loaded nodes in osi into the one of path; clo..rup hold the loaded values;
+	///dwork (5*ncol+2*nrow+2) and iwork (2*ncol+2) are scratch, ncol and nrow those of the core
+	void updateScenarioSolver(OsiSolverInterface *osi, std::vector<SmiScnNode *> &loaded, std::vector<SmiScnNode *> &path,
+		double *clo, double *cup, double *obj, double *rlo, double *rup, double *denseRow, double *dwork, int *iwork);
+	///solves every scenario problem, stage 0 columns fixed to fixedCols if given, for solveWS and solveEEV
+	void solveScenarios(OsiSolverInterface *osiSolver, double objSense, const double *fixedCols, std::vector<double> &objValues);
+	///merged stochastic row i of node, sorted; goes through denseRow (or the node's own) if the combine rule has no sparse path
+	int combineNodeRow(SmiNodeData *node, int i, double *dels, int *indx, double *denseRow);
+	///builds the det. eq. arrays and matrix_ from placed nodes; virtual nodes only get column bounds
+	void fillSolverArrays(std::vector<SmiScnNode *> &nodes, std::vector<bool> &included);
+	///loads the det. eq. of nodes (parents first) into osiStoch_; nodes before stage are virtual
+	OsiSolverInterface * loadSubproblemNodes(std::vector<SmiScnNode *> &nodes, int stage);
+	///fillSolverArrays for row-ordered output
+	void generateRowOrderedArrays(std::vector<SmiScnNode *> &nodes, std::vector<bool> &included);
+	///fillSolverArrays for column-ordered output
+	void generateColumnOrderedArrays(std::vector<SmiScnNode *> &nodes, std::vector<bool> &included);
+	///exact number of matrix elements of a node in the det. eq.; wdels/windx are work arrays
+	int countNodeElements(SmiScnNode *tnode, double *wdels, int *windx, double *denseRow);
+	///change of the core column counts of a node's stage by its merged stochastic rows, one (column, change) per column in column order
+	void countColumnDeltas(SmiScnNode *tnode, double *wdels, int *windx, double *denseRow, std::vector<std::pair<int,int> > &delta);
+	///appends the elements of the node's rows in core columns [jlo,jhi) to the det. eq. columns; cpos is indexed by core column
+	void fillNodeColumns(SmiScnNode *tnode, int jlo, int jhi, int *cpos, double *wdels, int *windx, double *denseRow);
+	///makes sure columnNode and rowNode hold at least ncol and nrow entries
+	void reserveNodeMaps(int ncol, int nrow);
+	///loads or assigns the generated arrays into osiStoch_
+	void passSolverData();
+	///scenario reduction to numScenarios or more scenarios, within tolerance
+	double reduceTree(int numScenarios, double tolerance, SmiScenarioReduction::Method method);
+	///rebuilds the tree from the kept scenarios, with prob indexed by old scenario
+	void keepScenarios(const std::vector<int> &kept, const std::vector<double> &prob);
+	///generateScenario from a matrix, or from triplets if matrix is NULL
+	SmiScenarioIndex generateScenarioPath(SmiCoreData *core, CoinPackedMatrix *matrix,
+		int numTriplets, const int *rows, const int *cols, const double *els,
+		CoinPackedVector *dclo, CoinPackedVector *dcup, CoinPackedVector *dobj,
+		CoinPackedVector *drlo, CoinPackedVector *drup,
+		SmiStageIndex branch, SmiScenarioIndex anc, double prob, SmiCoreCombineRule *r);
+	///returns node data equal to node from the share table, deleting node, or enters node into the table
+	SmiNodeData *internNodeData(SmiNodeData *node);
+
     // scenario tree 
     SmiScenarioTree<SmiScnNode *> smiTree_;
 
@@ -366,6 +634,29 @@ private:
 
     std::vector<int> intIndices;
     int* maxNelsPerScenInStage;
+
+    // number of threads used to generate the deterministic equivalent
+    int numThreads_;
+
+    // number of tree nodes in osiStoch_, or 0 if it does not hold the det. eq.
+    int numNodesLoaded_;
+
+    // hand the det. eq. to osiStoch_ with assignProblem instead of copying it
+    bool assignSolverData_;
+
+    // generate the det. eq. matrix column-ordered
+    bool colOrdered_;
+
+    // keep the scenario problem in the solver between WS/EEV scenarios
+    bool warmScenarios_;
+
+    // share equal node data between tree nodes
+    bool shareNodeData_;
+    // shared node data by content hash
+    std::multimap<unsigned int, SmiNodeData *> nodeDataTable_;
+
+    // arrays of generated node data
+    SmiNodeDataArena *nodeArena_;
 };
 
 class SmiScnNode
@@ -410,7 +701,8 @@ public:
         if (node_)
         {
             //Only delete non-core nodes. Core nodes get deleted via SmiCoreData..
-            if (!node_->isCoreNode()){
+            //Shared nodes are deleted by the last tree node holding them
+            if (!node_->isCoreNode() && node_->deletePtr() == 0){
                 delete node_;
                 node_= NULL;
             }
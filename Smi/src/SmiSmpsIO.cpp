@@ -15,6 +15,14 @@
 #include "CoinMessage.hpp"
 #include "CoinError.hpp"
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define SMI_HAS_MMAP
+#endif
+
 
 #if 1
 const static char *section[] = {
@@ -39,7 +47,7 @@ SmiSmpsIO::readTimeFile(SmiScnModel *smi, const char *c, const char *ext)
           return NULL;
         } else if (returnCode>0) {
           // delete cardReader_;
-          smpsCardReader_ = new SmiSmpsCardReader ( input, this);
+          smpsCardReader_ = newCardReader(input);
         }
 	
 	smpsCardReader_->readToNextSection();
@@ -184,7 +192,7 @@ SmiSmpsIO::readStochFile(SmiScnModel *smi,SmiCoreData *core, const char *c, cons
           return -1;
         } else if (returnCode>0) {
           delete smpsCardReader_;
-          smpsCardReader_ = new SmiSmpsCardReader ( input, this);
+          smpsCardReader_ = newCardReader(input);
 		  if(combineRuleSet)
 			  smpsCardReader_->setCoreCombineRule(combineRule_);
         }
@@ -361,12 +369,11 @@ SmiSmpsIO::readStochFile(SmiScnModel *smi,SmiCoreData *core, const char *c, cons
 			int scen=0,anc=0;
 			int branch=0;
 			CoinPackedVector drlo,drup,dclo,dcup,dobj;
-			CoinPackedMatrix *matrix = new CoinPackedMatrix(false,0.25,0.25);
-			assert(!matrix->isColOrdered());
-
-			int nrow = core->getNumRows();
-			int ncol = core->getNumCols();
-			matrix->setDimensions(nrow,ncol);
+			// matrix entries of the current scenario as triplets; the buffer
+			// keeps its capacity from scenario to scenario. Repeated entries
+			// are resolved (the last one counts) when the nodes are built.
+			std::vector<int> rows, cols;
+			std::vector<double> els;
 
 			while( smpsCardReader_->nextSmpsField (  ) == SMI_SCENARIOS_SECTION ) 
 			{
@@ -375,15 +382,16 @@ SmiSmpsIO::readStochFile(SmiScnModel *smi,SmiCoreData *core, const char *c, cons
 					if (scen)
 					{
 						
-						smi->generateScenario(core,matrix,&dclo,&dcup,&dobj,&drlo,&drup,branch,anc,prob,smpsCardReader_->getCoreCombineRule() );
-						matrix->clear();
+						smi->generateScenario(core,static_cast<int>(els.size()),els.empty() ? NULL : &rows[0],els.empty() ? NULL : &cols[0],els.empty() ? NULL : &els[0],
+							&dclo,&dcup,&dobj,&drlo,&drup,branch,anc,prob,smpsCardReader_->getCoreCombineRule() );
+						rows.clear();
+						cols.clear();
+						els.clear();
 						dclo.clear();
 						dcup.clear();
 						dobj.clear();
 						drlo.clear();
 						drup.clear();
-						
-						matrix->setDimensions(nrow,ncol);
 
 					}
 
@@ -440,7 +448,9 @@ SmiSmpsIO::readStochFile(SmiScnModel *smi,SmiCoreData *core, const char *c, cons
 					}
 					else	// add element
 					{
-						matrix->modifyCoefficient(i,j,value,true);
+						rows.push_back(i);
+						cols.push_back(j);
+						els.push_back(value);
 					}
 				}
 				
@@ -454,10 +464,10 @@ SmiSmpsIO::readStochFile(SmiScnModel *smi,SmiCoreData *core, const char *c, cons
 					if (scen)
 					{
 						
-						smi->generateScenario(core,matrix,&dclo,&dcup,&dobj,&drlo,&drup,branch,anc,prob,smpsCardReader_->getCoreCombineRule() );
+						smi->generateScenario(core,static_cast<int>(els.size()),els.empty() ? NULL : &rows[0],els.empty() ? NULL : &cols[0],els.empty() ? NULL : &els[0],
+							&dclo,&dcup,&dobj,&drlo,&drup,branch,anc,prob,smpsCardReader_->getCoreCombineRule() );
 						
 					}
-					delete matrix;
 					return 0;
 				}
 
@@ -477,88 +487,275 @@ SmiSmpsIO::readStochFile(SmiScnModel *smi,SmiCoreData *core, const char *c, cons
 }
 
 //#############################################################################
-//  nextSmpsField
+//  memory mapped files
+
+SmiSmpsMappedFile *
+SmiSmpsMappedFile::open(const char *filename)
+{
+#ifdef SMI_HAS_MMAP
+	int fd = ::open(filename,O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	struct stat st;
+	if (fstat(fd,&st) || !S_ISREG(st.st_mode) || st.st_size < 2)
+	{
+		::close(fd);
+		return NULL;
+	}
+	size_t size = static_cast<size_t>(st.st_size);
+	void *data = mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	// gzip and bzip2 files go through CoinFileInput
+	const unsigned char *magic = static_cast<const unsigned char *>(data);
+	if ((magic[0] == 0x1f && magic[1] == 0x8b) || (magic[0] == 'B' && magic[1] == 'Z'))
+	{
+		munmap(data,size);
+		return NULL;
+	}
+	madvise(data,size,MADV_SEQUENTIAL);
+	return new SmiSmpsMappedFile(static_cast<const char *>(data),size);
+#else
+	return NULL;
+#endif
+}
+
+SmiSmpsMappedFile::SmiSmpsMappedFile(const char *data, size_t size):
+	data_(data),size_(size),next_(data)
+{
+}
+
+SmiSmpsMappedFile::~SmiSmpsMappedFile()
+{
+#ifdef SMI_HAS_MMAP
+	munmap(const_cast<char *>(data_),size_);
+#endif
+}
+
+bool
+SmiSmpsMappedFile::nextLine(const char *&line, const char *&lineEnd)
+{
+	const char *end = data_+size_;
+	if (next_ == end)
+		return false;
+
+	line = next_;
+	const char *nl = static_cast<const char *>(memchr(next_,'\n',end-next_));
+	if (nl)
+	{
+		lineEnd = nl;
+		next_ = nl+1;
+	}
+	else
+		lineEnd = next_ = end;
+
+	// as CoinMpsCardReader::cleanCard
+	while (lineEnd != line && (lineEnd[-1] == ' ' || lineEnd[-1] == '\t' || lineEnd[-1] == '\r'))
+		--lineEnd;
+	return true;
+}
+
+SmiSmpsCardReader *
+SmiSmpsIO::newCardReader(CoinFileInput *input)
+{
+	SmiSmpsMappedFile *mapped = memoryMapping_ ? SmiSmpsMappedFile::open(fileName_) : NULL;
+	if (!mapped)
+		return new SmiSmpsCardReader(input,this);
+	delete input;
+	return new SmiSmpsCardReader(mapped,this);
+}
+
+//#############################################################################
+//  cards of SmiSmpsCardReader
 
+namespace {
+void
+copySmpsField(char *dest, const char *field, int len)
+{
+	if (len > COIN_MAX_FIELD_LENGTH-1)
+		len = COIN_MAX_FIELD_LENGTH-1;
+	memcpy(dest,field,len);
+	dest[len] = '\0';
+}
 
+double
+smpsFieldValue(const char *field, int len)
+{
+	char valstr[COIN_MAX_FIELD_LENGTH],*after;
+	copySmpsField(valstr,field,len);
+	double value = osi_strtod(valstr,&after,0);
+	// see if error
+	assert(after>valstr);
+	return value;
+}
+}
+
+int
+SmiSmpsCardReader::nextCard()
+{
+	if (!mapped_)
+	{
+		if ( cleanCard() )
+			return 1;
+		position_ = card_;
+		eol_ = card_ + strlen ( card_ );
+		return 0;
+	}
+
+	const char *line, *lineEnd;
+	if (!mapped_->nextLine(line,lineEnd))
+		return 1;
+	cardNumber_++;
+	// never written through
+	position_ = const_cast<char *>(line);
+	eol_ = const_cast<char *>(lineEnd);
+	return 0;
+}
+
+void
+SmiSmpsCardReader::copyCard()
+{
+	if (position_ == card_)
+		return;
+	size_t len = eol_ - position_;
+	if (len > MAX_CARD_LENGTH-1)
+		len = MAX_CARD_LENGTH-1;
+	memcpy(card_,position_,len);
+	card_[len] = '\0';
+	position_ = card_;
+	eol_ = card_ + len;
+}
+
+bool
+SmiSmpsCardReader::nextField(const char *&field, int &len)
+{
+	while ( position_ != eol_ && ( *position_ == ' ' || *position_ == '\t' ) )
+		position_++;
+	if ( position_ == eol_ )
+		return false;
+	field = position_;
+	while ( position_ != eol_ && *position_ != ' ' && *position_ != '\t' )
+		position_++;
+	len = static_cast<int>(position_ - field);
+	return true;
+}
+
+COINSectionType
+SmiSmpsCardReader::readToNextSection (  )
+{
+	if (!mapped_)
+		return CoinMpsCardReader::readToNextSection();
+
+	moreFields_ = false;
+	while ( !nextCard() )
+	{
+		// data cards and comments before the first section are skipped
+		if ( position_ != eol_ && ( *position_ == ' ' || *position_ == '*' ) )
+			continue;
+
+		copyCard();
+		handler_->message(COIN_MPS_LINE,messages_)<<cardNumber_
+			<<card_<<CoinMessageEol;
+		if ( !strncmp ( card_, "NAME", 4 ) || !strncmp ( card_, "TIME", 4 ) ||
+			!strncmp ( card_, "STOCH", 5 ) || !strncmp ( card_, "BASIS", 5 ) )
+		{
+			section_ = COIN_NAME_SECTION;
+			// the name is the first field after the keyword
+			position_ = card_ + std::min<size_t>(5,eol_-card_);
+			const char *next;
+			int len;
+			if ( nextField(next,len) )
+				copySmpsField(columnName_,next,len);
+			else
+				strcpy(columnName_,"no_name");
+		}
+		else
+			section_ = COIN_UNKNOWN_SECTION;
+		position_ = eol_ = card_;
+		return section_;
+	}
+	section_ = COIN_EOF_SECTION;
+	return section_;
+}
+
+//#############################################################################
+//  nextSmpsField
+
+// Fields are taken in place from the card, which is either card_ (read
+// through CoinFileInput) or a line of the mapped file.
 SmiSectionType
 SmiSmpsCardReader::nextSmpsField (  )
 {
-  
-  // find next non blank character
-  char *next = position_;
-
-  static const char *blanks = (const char *) " \t";
-  char valstr[COIN_MAX_FIELD_LENGTH],*after;
-  
-  while ( next != eol_ ) {
-    if ( *next == ' ' || *next == '\t' ) {
-      next++;
-    } else {
-      break;
-    }
-  }
+  const char *next;
+  int len;
+  char valstr[COIN_MAX_FIELD_LENGTH];
 
-  bool gotCard;
-  
-  if ( next == eol_ ) {
-	  gotCard = false;
-  } else {
-	  gotCard = true;
-  }
-  while ( !gotCard ) 
+  if ( moreFields_ )
   {
-	  // need new image
-	  
-	  if ( cleanCard() ) {
-		  return SMI_EOF_SECTION;
+	  // additional row fields on the line
+	  moreFields_ = false;
+	  strcpy(rowName_,periodName_); // stored the last field in periodName_
+
+	  if (!nextField(next,len))
+	  {
+		  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
+		  return smiSection_;
 	  }
-	  if ( card_[0] == ' ' ) {
-		  // not a section or comment
-		  position_ = card_;
-		  eol_ = card_ + strlen ( card_ );
+	  value_ = smpsFieldValue(next,len);
 
+	  if (nextField(next,len))
+	  {
+		  copySmpsField(periodName_,next,len); // store it here until next time
+		  moreFields_ = true;
+	  }
+	  return smiSection_;
+  }
+
+  while ( !nextCard() )
+  {
+	  if ( position_ != eol_ && *position_ == ' ' ) {
+		  // not a section or comment
 
 		  if ( smiSection_ == SMI_TIME_SECTION ) 
 		  {
 			  smiSmpsType_ = SMI_TIME_ORDERED_CORE_TYPE;
-			  if (!(next = strtok(position_,blanks)))
+			  if (!nextField(next,len))
 			  {
 				  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 				  return smiSection_;
 			  }
-			  strcpy(columnName_,next);
+			  copySmpsField(columnName_,next,len);
 			  
-			  if (!(next = strtok(NULL,blanks)))
+			  if (!nextField(next,len))
 			  {
 				  strcpy(periodName_,columnName_);
 				  smiSmpsType_ = SMI_TIME_UNORDERED_CORE_TYPE;
 				  return smiSection_;
 			  }
-			  strcpy(rowName_,next);
-			  if (!(next = strtok(NULL,blanks)))
+			  copySmpsField(rowName_,next,len);
+			  if (!nextField(next,len))
 			  {
 				  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 				  return smiSection_;
 			  }
-			  strcpy(periodName_,next);
+			  copySmpsField(periodName_,next,len);
 			  position_ = eol_;
 			  
 		  }
 
 		  if ( smiSection_ == SMI_INDEPENDENT_SECTION )
 		  {
-			  int i;
-			  if (strlen(next)==2)
+			  if (!nextField(next,len))
 			  {
-				  for (i = SMI_BL_CARD; i < SMI_UNKNOWN_MPS_TYPE; ++i) {
-					  if ( !strncmp ( next, smpsType[i], 2 ) ) 
-					  {
-						  break;
-					  }
-				  }
+				  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
+				  return smiSection_;
 			  }
-			  else
-				  i = SMI_COLUMN_CARD;
+
+			  int i = SMI_COLUMN_CARD;
+			  if (len==2 && !strncmp ( next, smpsType[SMI_BL_CARD], 2 ))
+				  i = SMI_BL_CARD;
 
 			  switch(smiSmpsType_ = (SmiSmpsType) i)
 			  {
@@ -566,49 +763,33 @@ SmiSmpsCardReader::nextSmpsField (  )
 				  break;
 				 
 			  case SMI_COLUMN_CARD: // card info has "col,row,value,prob"
-				    
-				  if (!(next = strtok(position_,blanks)))
-				  {
-					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
-					  return smiSection_;
-				  }
 				  //already got the name
-				  strcpy(columnName_,next);
+				  copySmpsField(columnName_,next,len);
 				  
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(rowName_,next);
+				  copySmpsField(rowName_,next,len);
 
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(valstr,next);
-
-				  value_ = osi_strtod(valstr,&after,0);
-				  // see if error
-				  assert(after>valstr);
+				  value_ = smpsFieldValue(next,len);
 					  
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(valstr,next);
-
-				  prob_ = osi_strtod(valstr,&after,0);
-				  // see if error
-				  assert(after>valstr);
+				  prob_ = smpsFieldValue(next,len);
 
 				  position_ = eol_;  //end of card -- no more information allowed
 				  break;
 
-			  case SMI_UNKNOWN_MPS_TYPE:
-				  break;
 			  default:
 				  smiSmpsType_=SMI_UNKNOWN_MPS_TYPE;
 			  }//end switch
@@ -619,17 +800,14 @@ SmiSmpsCardReader::nextSmpsField (  )
 
 		  if ( smiSection_ == SMI_SCENARIOS_SECTION )
 		  {
-			
-
-			  
-			  if (!(next = strtok(position_,blanks)))
+			  if (!nextField(next,len))
 			  {
 				  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 				  return smiSection_;
 			  }
 			
 			  int i;
-			  if (strlen(next)==2)
+			  if (len==2)
 			  {
 				  for (i = SMI_SC_CARD; i < SMI_UNKNOWN_MPS_TYPE; ++i) {
 					  if ( !strncmp ( next, smpsType[i], 2 ) ) 
@@ -646,71 +824,61 @@ SmiSmpsCardReader::nextSmpsField (  )
 			  switch(smiSmpsType_ = (SmiSmpsType) i)
 			  {
 			  case SMI_SC_CARD:
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(columnName_,next);
+				  copySmpsField(columnName_,next,len);
 				  
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(rowName_,next);
+				  copySmpsField(rowName_,next,len);
 
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(valstr,next);
-
-				  value_ = osi_strtod(valstr,&after,0);
-				  // see if error
-				  assert(after>valstr);
+				  value_ = smpsFieldValue(next,len);
 
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(periodName_,next);
+				  copySmpsField(periodName_,next,len);
 
 				  // no futher strings allowed.
 				  position_=eol_;
 				  break;
-			  case SMI_UNKNOWN_MPS_TYPE:
-				  //this in case the column name has two characters!
 			  case SMI_COLUMN_CARD:
 
 				  //already got the name
-				  strcpy(columnName_,next);
+				  copySmpsField(columnName_,next,len);
 				  
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(rowName_,next);
+				  copySmpsField(rowName_,next,len);
 
-				  if (!(next = strtok(NULL,blanks)))
+				  if (!nextField(next,len))
 				  {
 					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
 					  break;
 				  }
-				  strcpy(valstr,next);
-
-				  value_ = osi_strtod(valstr,&after,0);
-				  // see if error
-				  assert(after>valstr);
+				  value_ = smpsFieldValue(next,len);
 				  
-				  if (!(next = strtok(NULL,blanks)))
-					  position_ = eol_;
-				  else
-					  // strcpy(next,periodName_); // store it here until next time
-					  strcpy(periodName_,next); // store it here until next time
+				  if (nextField(next,len))
+				  {
+					  copySmpsField(periodName_,next,len); // store it here until next time
+					  moreFields_ = true;
+				  }
 				  break;
 			  default:
 				  assert(smiSmpsType_ == SMI_UNKNOWN_MPS_TYPE);
@@ -720,17 +888,16 @@ SmiSmpsCardReader::nextSmpsField (  )
 		  
 		  return smiSection_;
 
-	  } else if ( card_[0] != '*' ) {
+	  } else if ( position_ == eol_ || *position_ != '*' ) {
 		  // not a comment, might be a section
 		  int i;
 		  
+		  copyCard();
 		  handler_->message(COIN_MPS_LINE,messages_)<<cardNumber_
 			  <<card_<<CoinMessageEol;
 
 		  // find the section, if there is one
 		  for ( i = SMI_NAME_SECTION; i < SMI_UNKNOWN_SECTION; i++ ) {
-			//printf("Comparing first 3 chars of %s with %s returns %d \n",
-			//	card_, section[i], strncmp(card_,section[i],3));
 			  if ( !strncmp ( card_, section[i], 3) ) {
 				  break;
 			  }
@@ -739,8 +906,6 @@ SmiSmpsCardReader::nextSmpsField (  )
 		  // didn't find anything so quit
 		  if (i==SMI_UNKNOWN_SECTION) return (SmiSectionType) i;
 
-		  position_ = card_;
-		  eol_ = card_;
 		  smiSection_ = ( SmiSectionType ) i;
 
 		  // if its a scenario card, need to process some more info
@@ -748,31 +913,32 @@ SmiSmpsCardReader::nextSmpsField (  )
 				(smiSection_ == SMI_INDEPENDENT_SECTION) )
 		  {
 			  i = SMI_SMPS_COMBINE_UNKNOWN;
-			  next = strtok(position_,blanks);
-			  
-			  if (!(next = strtok(NULL,blanks)))
+			  // section name, then DISCRETE, then the combine rule
+			  bool found = nextField(next,len);
+			  if (!found || !nextField(next,len))
 			  {
 				  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
-				  //break;
 			  }
-			  // find the section, if there is one
-			  // next card should be DISCRETE
-			  if (!(next = strtok(NULL,blanks)))
+			  if (!found || !nextField(next,len))
 			  {
 				  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
-				  //break;
+				  found = false;
 			  }
 			  // find the section, if there is one
-			  if (next == NULL) {
+			  if (!found) {
 			    i = SMI_SMPS_COMBINE_REPLACE; 
 			  } else {
+				  copySmpsField(valstr,next,len);
 			      for ( i = SMI_SMPS_COMBINE_ADD; i < SMI_SMPS_COMBINE_UNKNOWN; i++ ) {
-				      if ( !strncmp ( next, smpsType[i], strlen ( section[i] ) ) ) {
+				      if ( !strncmp ( valstr, smpsType[i], strlen ( section[i] ) ) ) {
 					      break;
 				      }
 			      }
 			  }
 		   }
+		   position_ = card_;
+		   eol_ = card_;
+
 			  // set combine rule if it is not already set.
 		   if (!combineRuleSet)
 		   {
@@ -796,31 +962,8 @@ SmiSmpsCardReader::nextSmpsField (  )
 		  // comment
 	  }
   }
-  
-  {
-	  // if we get here, there are additional row fields on the line
 
-				  strcpy(rowName_,periodName_); // stored the last field in periodName_
-				  
-				  if (!(next = strtok(NULL,blanks)))
-				  {
-					  smiSmpsType_ = SMI_UNKNOWN_MPS_TYPE;
-					  return smiSection_;
-				  }
-				  strcpy(valstr,next);
-				  
-				  value_ = osi_strtod(valstr,&after,0);
-				  // see if error
-				  assert(after>valstr);
-
-				  if (!(next = strtok(NULL,blanks)))
-					  position_ = eol_;
-				  else
-					  strcpy(next,periodName_);
-				  
-				  
-				  return smiSection_;
-  }
+  return SMI_EOF_SECTION;
 }
 
 std::string SmiSmpsIO::getModProblemName() {
@@ -1017,36 +1160,40 @@ void SmiSmpsIO::writeStochFile(const char* filename, const char* extension, cons
 }
 
 void SmiSmpsIO::writeScenarioToStochFile(std::ostringstream& stream, SmiTreeNode<SmiScnNode *> * node, int scenario, bool strictFormat) {
-    // first, go up the tree - if possible and the parent node is still within the same scenario and not the root node
-    // if thats not the case, we reached the first node for that scenario
-    if (node->hasParent() && node->getParent()->scenario() == scenario && node->getParent() != tree->getRoot()) {
-        // go up the tree
-        writeScenarioToStochFile(stream, node->getParent(), scenario, strictFormat);
-    } else {
-        // write scenario card
-        stream << " SC Scen_" << std::setw(5) << std::left << node->scenario();
+    // first, go up the tree - as long as the parent node is still within the same scenario and not the root node
+    // then we reached the first node for that scenario
+    while (node->hasParent() && node->getParent()->scenario() == scenario && node->getParent() != tree->getRoot())
+        node = node->getParent();
 
-        if (node->getParent() != tree->getRoot()) {
-            // branches from parent scenario
-            stream << "Scen_" << std::setw(5) << std::left << node->getParent()->scenario();
-        } else {
-            // branches from root, i.e. Scen_0.
-            if (scenario == 0) // First Scenario (Scen_0) branches from ROOT, other scenarios branches from Scen_0
-                stream << std::setw(10) << std::left << "'ROOT'";
-            else
-                stream << std::setw(10) << std::left << "Scen_0";
-        }
+    // write scenario card
+    stream << " SC Scen_" << std::setw(5) << std::left << node->scenario();
 
-        if (strictFormat)
-            stream << std::setw(15) << std::left << tree->getLeaf(scenario)->getDataPtr()->getProb(); // write the probabilty
+    if (node->getParent() != tree->getRoot()) {
+        // branches from parent scenario
+        stream << "Scen_" << std::setw(5) << std::left << node->getParent()->scenario();
+    } else {
+        // branches from root, i.e. Scen_0.
+        if (scenario == 0) // First Scenario (Scen_0) branches from ROOT, other scenarios branches from Scen_0
+            stream << std::setw(10) << std::left << "'ROOT'";
         else
-            stream << tree->getLeaf(scenario)->getDataPtr()->getProb() << " "; // write the probabilty
-
-        stream << "STAGE_" << node->getDataPtr()->getStage() << "\n"; // write the stage number
+            stream << std::setw(10) << std::left << "Scen_0";
     }
-    
-    // now we can print the stochastic data
-    SmiNodeData* data = node->getDataPtr()->getNode();
+
+    if (strictFormat)
+        stream << std::setw(15) << std::left << tree->getLeaf(scenario)->getDataPtr()->getProb(); // write the probabilty
+    else
+        stream << tree->getLeaf(scenario)->getDataPtr()->getProb() << " "; // write the probabilty
+
+    stream << "STAGE_" << node->getDataPtr()->getStage() << "\n"; // write the stage number
+
+    // now write the nodes of the scenario down to the leaf
+    SmiScenarioPathIterator<SmiScnNode *> end = tree->pathEnd(scenario);
+    for (SmiScenarioPathIterator<SmiScnNode *> it(tree, scenario, node->depth()); it != end; ++it)
+        writeNodeToStochFile(stream, (*it)->getNode());
+}
+
+void SmiSmpsIO::writeNodeToStochFile(std::ostringstream& stream, SmiNodeData* data) {
+    // print the stochastic data
     if (data->getNumMatrixElements() > 0) {
         // write matrix elements
         for (int i = data->getCore()->getRowStart(data->getStage()); i < data->getCore()->getRowStart(data->getStage()+1); i++) {
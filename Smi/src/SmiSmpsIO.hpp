@@ -38,11 +38,41 @@ enum SmiSmpsType { SMI_SC_CARD, SMI_BL_CARD, SMI_COLUMN_CARD, SMI_DISCRETE_DIST,
 	SMI_TIME_UNORDERED_CORE_TYPE, SMI_TIME_ORDERED_CORE_TYPE
 };
 
+/** SmiSmpsMappedFile: read-only memory map of an uncompressed SMPS file
+
+Lets SmiSmpsCardReader tokenize cards in place instead of copying every
+line through CoinFileInput. open returns NULL if the file cannot be
+mapped: compressed files, empty files and platforms without mmap are
+read through CoinFileInput as before.
+*/
+class SmiSmpsMappedFile
+{
+public:
+	static SmiSmpsMappedFile *open(const char *filename);
+	~SmiSmpsMappedFile();
+
+	/** Next line, without the newline and trailing blanks or carriage
+	    return; false at end of file. */
+	bool nextLine(const char *&line, const char *&lineEnd);
+
+private:
+	SmiSmpsMappedFile(const char *data, size_t size);
+	SmiSmpsMappedFile(const SmiSmpsMappedFile &);
+	SmiSmpsMappedFile &operator=(const SmiSmpsMappedFile &);
+
+	const char *data_;
+	size_t size_;
+	// start of the next line
+	const char *next_;
+};
+
 class SmiSmpsCardReader:
 public CoinMpsCardReader
 {
 public:
 	  SmiSectionType nextSmpsField (  );
+	  /// as CoinMpsCardReader::readToNextSection, for mapped files too
+	  COINSectionType readToNextSection (  );
 	  SmiSectionType whichSmpsSection(){return smiSection_;}
 	    
 	  SmiSmpsType whichSmpsType() {return smiSmpsType_;}
@@ -59,9 +89,21 @@ public:
 	  /// Constructor expects file to be open 
 	  /// This one takes gzFile if fp null
 	  SmiSmpsCardReader( CoinFileInput *input, CoinMpsIO * reader ):CoinMpsCardReader (input,reader ),
-		combineRuleSet(false),prob_(0.0){}
+		combineRuleSet(false),prob_(0.0),mapped_(NULL),moreFields_(false){}
+	  /// Reads cards in place from a mapped file, which it takes over
+	  SmiSmpsCardReader( SmiSmpsMappedFile *file, CoinMpsIO * reader ):CoinMpsCardReader (NULL,reader ),
+		combineRuleSet(false),prob_(0.0),mapped_(file),moreFields_(false){}
 
-	  ~SmiSmpsCardReader(){}
+	  ~SmiSmpsCardReader(){ delete mapped_; }
+
+	  bool isMapped() { return mapped_ != NULL; }
+private:
+	  /// makes position_..eol_ the next card; returns 1 at end of file
+	  int nextCard();
+	  /// copies the card at position_ into card_, for section cards
+	  void copyCard();
+	  /// next blank-delimited field of the card, in place
+	  bool nextField(const char *&field, int &len);
 private:
 	 /// Current third name (for SmpsIO)
 	char periodName_[COIN_MAX_FIELD_LENGTH];
@@ -71,6 +113,9 @@ private:
 	SmiCoreCombineRule *combineRule_;
 	bool combineRuleSet;
 	double prob_;
+	SmiSmpsMappedFile *mapped_;
+	/// the card holds more row fields, the first one in periodName_
+	bool moreFields_;
 };
 
 class SmiSmpsIO: 
@@ -90,9 +135,13 @@ public:
     inline double getSolverInfinity() const { return solverInf_; }
 
 	void writeSmps(const char* filename, bool winFileExtensions = false, bool strictFormat = true);
+
+	/// read uncompressed time and stoch files through a memory map (default true)
+	inline void setMemoryMapping(bool b) { memoryMapping_ = b; }
+	inline bool getMemoryMapping() { return memoryMapping_; }
 public:
-	SmiSmpsIO():CoinMpsIO(),nstag_(0),cstag_(NULL),rstag_(NULL),solverInf_(COIN_DBL_MAX),iftime(false),ifstoch(false),smpsCardReader_(NULL),combineRule_(NULL),combineRuleSet(false),core(NULL),tree(NULL),periodMap_(),scenarioMap_() {}
-    SmiSmpsIO(SmiCoreData * core, SmiScenarioTree<SmiScnNode *> * smiTree):CoinMpsIO(),nstag_(0),cstag_(NULL),rstag_(NULL),solverInf_(COIN_DBL_MAX),iftime(false),ifstoch(false),smpsCardReader_(NULL),combineRule_(NULL),combineRuleSet(false),core(core),tree(smiTree),periodMap_(),scenarioMap_() {}
+	SmiSmpsIO():CoinMpsIO(),nstag_(0),cstag_(NULL),rstag_(NULL),solverInf_(COIN_DBL_MAX),iftime(false),ifstoch(false),smpsCardReader_(NULL),combineRule_(NULL),combineRuleSet(false),core(NULL),tree(NULL),periodMap_(),scenarioMap_(),memoryMapping_(true) {}
+    SmiSmpsIO(SmiCoreData * core, SmiScenarioTree<SmiScnNode *> * smiTree):CoinMpsIO(),nstag_(0),cstag_(NULL),rstag_(NULL),solverInf_(COIN_DBL_MAX),iftime(false),ifstoch(false),smpsCardReader_(NULL),combineRule_(NULL),combineRuleSet(false),core(core),tree(smiTree),periodMap_(),scenarioMap_(),memoryMapping_(true) {}
 
     ~SmiSmpsIO(){delete [] cstag_;delete[] rstag_;delete smpsCardReader_;}
 private:
@@ -129,6 +178,11 @@ private:
     Writes the stochastic informations for the given scenario into the stream.
     */
     void writeScenarioToStochFile(std::ostringstream& stream, SmiTreeNode<SmiScnNode *> * node, int scenario, bool strictFormat);
+
+    /**
+    Writes the stochastic data of a single node into the stream.
+    */
+    void writeNodeToStochFile(std::ostringstream& stream, SmiNodeData* data);
     
     std::string getModProblemName(); // get the (probably modified) problem name
 
@@ -149,6 +203,10 @@ private:
     StringIntMap periodMap_;
     StringIntMap scenarioMap_;
 
+    bool memoryMapping_;
+
+    /// card reader for the file just opened by dealWithFileName, mapped if possible
+    SmiSmpsCardReader *newCardReader(CoinFileInput *input);
 };
 
 
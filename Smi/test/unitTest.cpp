@@ -3,10 +3,17 @@
 
 
 #include <string>
+#include <set>
+#include <fstream>
 
 #define SMI_TEST_DATA_DIR  "SmiTestData"
 
 #include "SmiScnModel.hpp"
+#include "SmiSmpsIO.hpp"
+#include "SmiBendersSolver.hpp"
+#include "SmiScenarioWorkerPool.hpp"
+#include "SmiNestedBendersSolver.hpp"
+#include "SmiProgressiveHedgingSolver.hpp"
 #include "OsiClpSolverInterface.hpp"
 
 #include "CoinMpsIO.hpp"
@@ -30,6 +37,29 @@ void	testingMessage(const char* const);
 void	SmpsBug();
 void	DecompUnitTest();
 void ModelBugQP();
+void	SmiScnModelParallelUnitTest();
+void	SmiCoreCombineRuleUnitTest();
+void	SmiScnModelAppendUnitTest();
+void	SmiScnModelUpdateUnitTest();
+void	SmiScnModelAssignUnitTest();
+void	SmiScnModelColumnOrderedUnitTest();
+void	SmiScnModelSubproblemUnitTest();
+void	SmiScnModelWSUnitTest();
+void	SmiScnModelWarmScenarioUnitTest();
+void	SmiBendersSolverUnitTest();
+void	SmiScenarioWorkerPoolUnitTest();
+void	SmiNestedBendersSolverUnitTest();
+void	SmiProgressiveHedgingSolverUnitTest();
+void	SmiTreeArenaUnitTest();
+void	SmiTreeTeardownUnitTest();
+void	SmiScenarioTreeFindUnitTest();
+void	SmiTreeLabelUnitTest();
+void	SmiScnModelReductionUnitTest();
+void	SmiScnModelShareNodeDataUnitTest();
+void	SmiNodeDataArenaUnitTest();
+void	SmiNodeDataTripletUnitTest();
+void	SmiSmpsIOScenarioMatrixUnitTest();
+void	SmiSmpsCardReaderMappedUnitTest();
 
 int main()
 {
@@ -62,6 +92,53 @@ int main()
 	DecompUnitTest();
 
 	ModelBugQP();
+
+	//testingMessage("Parallel generation of deterministic equivalent.");
+	SmiScnModelParallelUnitTest();
+
+	SmiCoreCombineRuleUnitTest();
+
+	SmiScnModelAppendUnitTest();
+
+	SmiScnModelUpdateUnitTest();
+
+	SmiScnModelAssignUnitTest();
+
+	SmiScnModelColumnOrderedUnitTest();
+
+	SmiScnModelSubproblemUnitTest();
+
+	SmiScnModelWSUnitTest();
+
+	SmiScnModelWarmScenarioUnitTest();
+
+	SmiBendersSolverUnitTest();
+
+	SmiScenarioWorkerPoolUnitTest();
+
+	SmiNestedBendersSolverUnitTest();
+
+	SmiProgressiveHedgingSolverUnitTest();
+
+	SmiTreeArenaUnitTest();
+
+	SmiTreeTeardownUnitTest();
+
+	SmiScenarioTreeFindUnitTest();
+
+	SmiTreeLabelUnitTest();
+
+	SmiScnModelReductionUnitTest();
+
+	SmiScnModelShareNodeDataUnitTest();
+
+	SmiNodeDataArenaUnitTest();
+
+	SmiNodeDataTripletUnitTest();
+
+	SmiSmpsIOScenarioMatrixUnitTest();
+
+	SmiSmpsCardReaderMappedUnitTest();
 	}
 	catch(string c){
 		cout << c << "\n";
@@ -667,7 +744,23 @@ SmiScenarioTreeUnitTest()
 	myAssert(__FILE__,__LINE__, *vbeg1++ == ii4 );
 	myAssert(__FILE__,__LINE__, vbeg1 == vend1 );
 
-
+	// path iterators give the same nodes without copying
+	SmiScenarioPathIterator<int *> pbeg = s.pathBegin(is3);
+	SmiScenarioPathIterator<int *> pend = s.pathEnd(is3);
+	myAssert(__FILE__,__LINE__, *pbeg++ == i1 );
+	myAssert(__FILE__,__LINE__, pbeg.stage() == 1 );
+	myAssert(__FILE__,__LINE__, *pbeg++ == i3 );
+	myAssert(__FILE__,__LINE__, *pbeg++ == i6 );
+	myAssert(__FILE__,__LINE__, pbeg == pend );
+	myAssert(__FILE__,__LINE__, *--pbeg == i6 );
+	myAssert(__FILE__,__LINE__, pbeg.node() == s.getLeaf(is3) );
+	myAssert(__FILE__,__LINE__, *--pbeg == i3 );
+
+	for (int is=0; is<s1.getNumScenarios(); is++)
+	{
+		vector<int *> path(s1.pathBegin(is),s1.pathEnd(is));
+		myAssert(__FILE__,__LINE__, path == s1.getScenario(is) );
+	}
 
 	delete i1;
 	delete i2;
@@ -2238,5 +2331,1228 @@ void SmpsBug()
 	delete clp;
 }
 
+void SmiScnModelParallelUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// serial and parallel generation must give identical DE data
+	SmiScnModel smi1, smi4;
+	myAssert(__FILE__,__LINE__,-1!=smi1.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,-1!=smi4.readSmps((dataDir+"/app0110").c_str()));
+	smi4.setNumThreads(4);
+
+	OsiClpSolverInterface *clp1 = new OsiClpSolverInterface();
+	OsiClpSolverInterface *clp4 = new OsiClpSolverInterface();
+	smi1.setOsiSolverHandle(*clp1);
+	smi4.setOsiSolverHandle(*clp4);
+	OsiSolverInterface *osi1 = smi1.loadOsiSolverData();
+	OsiSolverInterface *osi4 = smi4.loadOsiSolverData();
+
+	int nrows = osi1->getNumRows();
+	int ncols = osi1->getNumCols();
+	myAssert(__FILE__,__LINE__,nrows==osi4->getNumRows());
+	myAssert(__FILE__,__LINE__,ncols==osi4->getNumCols());
+
+	const CoinPackedMatrix *m1 = osi1->getMatrixByRow();
+	const CoinPackedMatrix *m4 = osi4->getMatrixByRow();
+	myAssert(__FILE__,__LINE__,m1->getNumElements()==m4->getNumElements());
+	int i,j;
+	for (i=0; i<nrows; i++)
+	{
+		const CoinShallowPackedVector r1 = m1->getVector(i);
+		const CoinShallowPackedVector r4 = m4->getVector(i);
+		myAssert(__FILE__,__LINE__,r1.getNumElements()==r4.getNumElements());
+		for (j=0; j<r1.getNumElements(); j++)
+		{
+			myAssert(__FILE__,__LINE__,r1.getIndices()[j]==r4.getIndices()[j]);
+			myAssert(__FILE__,__LINE__,r1.getElements()[j]==r4.getElements()[j]);
+		}
+		myAssert(__FILE__,__LINE__,osi1->getRowLower()[i]==osi4->getRowLower()[i]);
+		myAssert(__FILE__,__LINE__,osi1->getRowUpper()[i]==osi4->getRowUpper()[i]);
+	}
+	for (j=0; j<ncols; j++)
+	{
+		myAssert(__FILE__,__LINE__,osi1->getColLower()[j]==osi4->getColLower()[j]);
+		myAssert(__FILE__,__LINE__,osi1->getColUpper()[j]==osi4->getColUpper()[j]);
+		myAssert(__FILE__,__LINE__,osi1->getObjCoefficients()[j]==osi4->getObjCoefficients()[j]);
+	}
+
+	osi4->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osi4->getObjValue()-44.66666) < 0.0001);
+	printf(" *** Successfully tested parallel generation of deterministic equivalent.\n");
+
+	delete clp1;
+	delete clp4;
+}
+
+void SmiCoreCombineRuleUnitTest()
+{
+	// sparse merge must agree with the dense combine
+	const int ncol=8;
+	int cr_ind[]={ 0, 2, 3, 6 };
+	double cr_els[]={ 1.0, 2.0, 3.0, 4.0 };
+	int nr_ind[]={ 1, 2, 3, 7 };
+	double nr_els[]={ 5.0, -2.0, 1.0, 6.0 };
+
+	SmiCoreCombineRule *rules[2];
+	rules[0]=SmiCoreCombineReplace::Instance();
+	rules[1]=SmiCoreCombineAdd::Instance();
+
+	for (int r=0; r<2; r++)
+	{
+		double dr[ncol], dels1[ncol], dels2[ncol];
+		int indx1[ncol], indx2[ncol];
+		int j;
+
+		for (j=0; j<ncol; j++) dr[j]=0.0;
+		for (j=0; j<4; j++) dr[cr_ind[j]]=cr_els[j];
+
+		int n1=rules[r]->Process(dr,ncol,4,nr_ind,nr_els,dels1,indx1);
+		int n2=rules[r]->Process(4,cr_ind,cr_els,4,nr_ind,nr_els,dels2,indx2);
+		myAssert(__FILE__,__LINE__,n1==n2);
+		for (j=0; j<n1; j++)
+		{
+			myAssert(__FILE__,__LINE__,indx1[j]==indx2[j]);
+			myAssert(__FILE__,__LINE__,dels1[j]==dels2[j]);
+		}
+	}
+	printf(" *** Successfully tested sparse core combine rules.\n");
+}
+
+void SmiScnModelAppendUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// smi1 appends a scenario to the loaded det. eq., smi2 rebuilds it
+	SmiScnModel smi1, smi2;
+	myAssert(__FILE__,__LINE__,-1!=smi1.readSmps((dataDir+"/app0110R").c_str()));
+	myAssert(__FILE__,__LINE__,-1!=smi2.readSmps((dataDir+"/app0110R").c_str()));
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi1.setOsiSolverHandle(*clp);
+	smi2.setOsiSolverHandle(*clp);
+
+	OsiSolverInterface *osi1 = smi1.loadOsiSolverData();
+	osi1->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osi1->getObjValue()-44.66666) < 0.0001);
+
+	smi1.generateScenarioFromCore(0.25);
+	smi2.generateScenarioFromCore(0.25);
+
+	osi1 = smi1.appendScenariosToOsi();
+	OsiSolverInterface *osi2 = smi2.loadOsiSolverData();
+
+	myAssert(__FILE__,__LINE__,osi1->getNumRows()==osi2->getNumRows());
+	myAssert(__FILE__,__LINE__,osi1->getNumCols()==osi2->getNumCols());
+	myAssert(__FILE__,__LINE__,osi1->getNumElements()==osi2->getNumElements());
+	for (int j=0; j<osi1->getNumCols(); j++)
+		myAssert(__FILE__,__LINE__,fabs(osi1->getObjCoefficients()[j]-osi2->getObjCoefficients()[j]) < 1.0e-12);
+
+	osi1->resolve();
+	osi2->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osi1->getObjValue()-osi2->getObjValue()) < 0.0001);
+	printf(" *** Successfully tested appending scenarios to a loaded model.\n");
+
+	delete clp;
+}
+
+void SmiScnModelUpdateUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// smi1 refreshes the loaded det. eq., smi2 rebuilds it
+	SmiScnModel smi1, smi2;
+	myAssert(__FILE__,__LINE__,-1!=smi1.readSmps((dataDir+"/app0110R").c_str()));
+	myAssert(__FILE__,__LINE__,-1!=smi2.readSmps((dataDir+"/app0110R").c_str()));
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi1.setOsiSolverHandle(*clp);
+	smi2.setOsiSolverHandle(*clp);
+
+	OsiSolverInterface *osi1 = smi1.loadOsiSolverData();
+	osi1->initialSolve();
+
+	// nothing changed yet
+	myAssert(__FILE__,__LINE__,smi1.updateOsiSolverData()==0);
+
+	// new right hand side in the first scenario, same change in both models
+	SmiScnModel *smi[2] = { &smi1, &smi2 };
+	for (int m=0; m<2; m++)
+	{
+		SmiNodeData *node = smi[m]->getLeafNode(0)->getNode();
+		double *rlo = node->getMutableRowLowerElements();
+		double *rup = node->getMutableRowUpperElements();
+		for (int i=0; i<node->getRowLowerLength(); i++)
+			rlo[i] *= 1.1;
+		for (int i=0; i<node->getRowUpperLength(); i++)
+			rup[i] *= 1.1;
+	}
+
+	myAssert(__FILE__,__LINE__,smi1.updateOsiSolverData()>0);
+	osi1->resolve();
+
+	OsiSolverInterface *osi2 = smi2.loadOsiSolverData();
+	osi2->initialSolve();
+	for (int i=0; i<osi1->getNumRows(); i++)
+	{
+		myAssert(__FILE__,__LINE__,osi1->getRowLower()[i]==osi2->getRowLower()[i]);
+		myAssert(__FILE__,__LINE__,osi1->getRowUpper()[i]==osi2->getRowUpper()[i]);
+	}
+	myAssert(__FILE__,__LINE__,fabs(osi1->getObjValue()-osi2->getObjValue()) < 0.0001);
+	printf(" *** Successfully tested refresh of loaded model data.\n");
+
+	delete clp;
+}
+
+void SmiScnModelAssignUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// hand the det. eq. to the solver without keeping a copy
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110R").c_str()));
+	smi.setAssignSolverData(true);
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiStoch = smi.loadOsiSolverData();
+
+	myAssert(__FILE__,__LINE__,osiStoch->getNumRows()==129);
+	myAssert(__FILE__,__LINE__,osiStoch->getNumCols()==268);
+	osiStoch->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osiStoch->getObjValue()-44.66666) < 0.0001);
+
+	// solution queries only need the node offsets
+	double objSum = 0.0;
+	for (int is=0; is<smi.getNumScenarios(); is++)
+		objSum += smi.getObjectiveValue(is)*smi.getLeafNode(is)->getModelProb();
+	myAssert(__FILE__,__LINE__,fabs(osiStoch->getObjValue()-objSum) < 0.0001);
+
+	// appending works from the solver's data
+	smi.generateScenarioFromCore(0.25);
+	osiStoch = smi.appendScenariosToOsi();
+	osiStoch->resolve();
+	myAssert(__FILE__,__LINE__,osiStoch->isProvenOptimal());
+	printf(" *** Successfully tested assignProblem hand-off.\n");
+
+	delete clp;
+}
+
+void SmiScnModelColumnOrderedUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// row- and column-ordered generation must give the same det. eq.
+	SmiScnModel smiR, smiC;
+	myAssert(__FILE__,__LINE__,-1!=smiR.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,-1!=smiC.readSmps((dataDir+"/app0110").c_str()));
+	smiC.setColumnOrdered(true);
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smiR.setOsiSolverHandle(*clp);
+	smiC.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiR = smiR.loadOsiSolverData();
+	OsiSolverInterface *osiC = smiC.loadOsiSolverData();
+
+	myAssert(__FILE__,__LINE__,osiR->getNumRows()==osiC->getNumRows());
+	myAssert(__FILE__,__LINE__,osiR->getNumCols()==osiC->getNumCols());
+	const CoinPackedMatrix *mR = osiR->getMatrixByRow();
+	const CoinPackedMatrix *mC = osiC->getMatrixByRow();
+	myAssert(__FILE__,__LINE__,mR->getNumElements()==mC->getNumElements());
+	for (int i=0; i<osiR->getNumRows(); i++)
+	{
+		const CoinShallowPackedVector rR = mR->getVector(i);
+		const CoinShallowPackedVector rC = mC->getVector(i);
+		myAssert(__FILE__,__LINE__,rR.getNumElements()==rC.getNumElements());
+		for (int j=0; j<rR.getNumElements(); j++)
+			myAssert(__FILE__,__LINE__,rR[rC.getIndices()[j]]==rC.getElements()[j]);
+	}
+
+	// columns filled on several threads: same matrix, by column
+	SmiScnModel smiT;
+	myAssert(__FILE__,__LINE__,-1!=smiT.readSmps((dataDir+"/app0110").c_str()));
+	smiT.setColumnOrdered(true);
+	smiT.setNumThreads(4);
+	smiT.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiT = smiT.loadOsiSolverData();
+	const CoinPackedMatrix *cC = osiC->getMatrixByCol();
+	const CoinPackedMatrix *cT = osiT->getMatrixByCol();
+	myAssert(__FILE__,__LINE__,cC->getNumElements()==cT->getNumElements());
+	for (int j=0; j<osiC->getNumCols(); j++)
+	{
+		const CoinShallowPackedVector cj = cC->getVector(j);
+		const CoinShallowPackedVector tj = cT->getVector(j);
+		myAssert(__FILE__,__LINE__,cj.getNumElements()==tj.getNumElements());
+		for (int e=0; e<cj.getNumElements(); e++)
+		{
+			myAssert(__FILE__,__LINE__,cj.getIndices()[e]==tj.getIndices()[e]);
+			myAssert(__FILE__,__LINE__,cj.getElements()[e]==tj.getElements()[e]);
+		}
+	}
+
+	osiC->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osiC->getObjValue()-44.66666) < 0.0001);
+	printf(" *** Successfully tested column-ordered generation.\n");
+
+	delete clp;
+}
+
+void SmiScnModelSubproblemUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osi = smi.loadOsiSolverData();
+	osi->initialSolve();
+	double fullObj = osi->getObjValue();
+	int fullRows = osi->getNumRows();
+	int fullCols = osi->getNumCols();
+
+	// root solution and its cost
+	int nroot = smi.getRootNode()->getNumCols();
+	vector<double> xroot(osi->getColSolution(),osi->getColSolution()+nroot);
+	double rootObj = 0.0;
+	for (int j=0; j<nroot; j++)
+		rootObj += osi->getObjCoefficients()[j]*xroot[j];
+
+	// subtree of the root and the range of all scenarios are the whole model
+	osi = smi.loadOsiSolverDataForSubproblem(0,0);
+	myAssert(__FILE__,__LINE__,osi->getNumRows()==fullRows);
+	myAssert(__FILE__,__LINE__,osi->getNumCols()==fullCols);
+	osi->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osi->getObjValue()-fullObj) < 0.0001);
+
+	osi = smi.loadOsiSolverDataForSubproblem(0,0,smi.getNumScenarios());
+	myAssert(__FILE__,__LINE__,osi->getNumRows()==fullRows);
+	myAssert(__FILE__,__LINE__,osi->getNumCols()==fullCols);
+
+	// stage 1 subtrees with the root fixed add up to the full objective
+	double subObj = rootObj;
+	std::set<SmiScnNode *> done;
+	for (int is=0; is<smi.getNumScenarios(); is++)
+	{
+		SmiScnNode *tnode = smi.getLeafNode(is);
+		while (tnode->getStage() > 1)
+			tnode = tnode->getParent();
+		if (!done.insert(tnode).second)
+			continue;
+
+		osi = smi.loadOsiSolverDataForSubproblem(1,is);
+		myAssert(__FILE__,__LINE__,osi->getNumRows() < fullRows);
+		myAssert(__FILE__,__LINE__,smi.getRootNode()->getColStart()==0);
+		for (int j=0; j<nroot; j++)
+		{
+			myAssert(__FILE__,__LINE__,osi->getObjCoefficients()[j]==0.0);
+			osi->setColBounds(j,xroot[j],xroot[j]);
+		}
+		osi->initialSolve();
+		myAssert(__FILE__,__LINE__,osi->isProvenOptimal());
+		subObj += osi->getObjValue();
+	}
+	myAssert(__FILE__,__LINE__,done.size() > 1);
+	myAssert(__FILE__,__LINE__,fabs(subObj-fullObj) < 0.0001);
+
+	// the full model still loads after subproblems
+	osi = smi.loadOsiSolverData();
+	myAssert(__FILE__,__LINE__,osi->getNumRows()==fullRows);
+	osi->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osi->getObjValue()-fullObj) < 0.0001);
+	printf(" *** Successfully tested subproblem extraction.\n");
+
+	delete clp;
+}
+
+void SmiScnModelWSUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiStoch = smi.loadOsiSolverData();
+	osiStoch->initialSolve();
+	double rp = osiStoch->getObjValue();
+
+	// serial and parallel Wait-and-See give the same values, in scenario order
+	vector< pair<double,double> > ws1 = smi.solveWS(clp,1.0);
+	smi.setNumThreads(4);
+	vector< pair<double,double> > ws4 = smi.solveWS(clp,1.0);
+	myAssert(__FILE__,__LINE__,ws1.size()==(unsigned int)smi.getNumScenarios());
+	myAssert(__FILE__,__LINE__,ws4.size()==ws1.size());
+	double wsValue = 0.0;
+	for (unsigned int is=0; is<ws1.size(); is++)
+	{
+		myAssert(__FILE__,__LINE__,fabs(ws1[is].first-ws4[is].first) < 1.0e-8);
+		myAssert(__FILE__,__LINE__,ws1[is].second==smi.getLeafNode(is)->getProb());
+		myAssert(__FILE__,__LINE__,ws4[is].second==ws1[is].second);
+		wsValue += ws1[is].first*ws1[is].second;
+	}
+	myAssert(__FILE__,__LINE__,fabs(smi.getWSValue(clp,1.0)-wsValue) < 1.0e-8);
+
+	// perfect information can only help
+	myAssert(__FILE__,__LINE__,wsValue <= rp + 0.0001);
+
+	// the loaded det. eq. is still there
+	myAssert(__FILE__,__LINE__,smi.getOsiSolverInterface()==osiStoch);
+	osiStoch->resolve();
+	myAssert(__FILE__,__LINE__,fabs(osiStoch->getObjValue()-rp) < 0.0001);
+	printf(" *** Successfully tested Wait-and-See solves.\n");
+
+	delete clp;
+}
+
+void SmiScnModelWarmScenarioUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+
+	// scenarios loaded from scratch
+	vector< pair<double,double> > wsCold = smi.solveWS(clp,1.0);
+	double eevCold = smi.solveEEV(clp,1.0);
+
+	// scenarios changed in place, on one and on two workers
+	smi.setWarmStartScenarios(true);
+	for (int nt=1; nt<=2; nt++)
+	{
+		smi.setNumThreads(nt);
+		vector< pair<double,double> > wsWarm = smi.solveWS(clp,1.0);
+		myAssert(__FILE__,__LINE__,wsWarm.size()==wsCold.size());
+		for (unsigned int is=0; is<wsCold.size(); is++)
+			myAssert(__FILE__,__LINE__,fabs(wsWarm[is].first-wsCold[is].first) < 0.0001);
+		myAssert(__FILE__,__LINE__,fabs(smi.solveEEV(clp,1.0)-eevCold) < 0.0001);
+	}
+	printf(" *** Successfully tested warm-started scenario solves.\n");
+
+	delete clp;
+}
+
+void SmiBendersSolverUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// two-stage model Bug: same value as the det. eq., single- and multi-cut
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/bug").c_str()));
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiStoch = smi.loadOsiSolverData();
+	osiStoch->initialSolve();
+	double detEq = osiStoch->getObjValue();
+
+	for (int multi=0; multi<2; multi++)
+	{
+		SmiBendersSolver benders(&smi,clp);
+		benders.setMultiCut(multi==1);
+		myAssert(__FILE__,__LINE__,benders.solve()==0);
+		myAssert(__FILE__,__LINE__,fabs(benders.getObjValue()-detEq) < 0.0001);
+		myAssert(__FILE__,__LINE__,benders.getLowerBound() <= benders.getUpperBound());
+		myAssert(__FILE__,__LINE__,benders.getNumOptimalityCuts() > 0);
+		myAssert(__FILE__,__LINE__,benders.getColSolution()!=NULL);
+	}
+
+	/* Bug without recourse: the stage 1 columns are fixed at zero,
+	 * so the first master solution x=0 gives infeasible subproblems.
+	 *
+	 *    minimize x01 + x02 + x03
+	 *      C1 <=  x01 + x02
+	 *      C2 <=      + x02 + x03
+	 *      C3 <=  x01       + x03
+	 *    (C1, C2, C3) = ( 1, 1, 0) or ( 0, 1, 0)
+	 */
+	double INF=clp->getInfinity();
+	int iColStarts[] = {0,3,6,9,11,13,15};
+	int iRowIndice[] = {3,1,0, 2,1,0, 3,2,0, 3,1, 2,1, 3,2};
+	double dEls[] = {1,1,1, 1,1,1, 1,1,1, 1,1, 1,1, 1,1};
+	double dClo[] = {0,0,0,0,0,0};
+	double dCup[] = {INF,INF,INF,0,0,0};
+	double dObj[] = {1,1,1,0.5,0.5,0.5};
+	double dRlo[] = {0,1,1,1};
+	double dRup[] = {INF,INF,INF,INF};
+	int iColStages[] = {0,0,0,1,1,1};
+	int iRowStages[] = {0,1,1,1};
+	OsiClpSolverInterface osi;
+	osi.loadProblem(6,4,iColStarts,iRowIndice,dEls,dClo,dCup,dObj,dRlo,dRup);
+	SmiCoreData *core = new SmiCoreData(&osi,2,iColStages,iRowStages);
+
+	int indices[] = {1,2,3};
+	double drlo0[] = {1.0,1.0,0.0};
+	double drlo1[] = {0.0,1.0,0.0};
+	CoinPackedVector rlo0(3,indices,drlo0);
+	CoinPackedVector rlo1(3,indices,drlo1);
+	SmiScnModel *smiF = new SmiScnModel();
+	smiF->generateScenario(core,NULL,NULL,NULL,NULL,&rlo0,NULL,1,0,0.5);
+	smiF->generateScenario(core,NULL,NULL,NULL,NULL,&rlo1,NULL,1,0,0.5);
+
+	SmiBendersSolver bendersF(smiF,clp);
+	myAssert(__FILE__,__LINE__,bendersF.solve()==0);
+	myAssert(__FILE__,__LINE__,bendersF.getNumFeasibilityCuts() > 0);
+	myAssert(__FILE__,__LINE__,fabs(bendersF.getObjValue()-1.0) < 0.0001);
+	printf(" *** Successfully tested L-shaped decomposition.\n");
+
+	delete smiF;
+	delete core;
+	delete clp;
+}
+
+// records which worker evaluated each index
+class SmiTestPoolVisit
+{
+public:
+	SmiTestPoolVisit(std::vector<int> &owner, std::vector<OsiSolverInterface *> &solver):owner_(owner),solver_(solver) {}
+	void operator() (OsiSolverInterface *osi, int worker, int i)
+	{
+		owner_[i] = worker;
+		solver_[i] = osi;
+	}
+private:
+	std::vector<int> &owner_;
+	std::vector<OsiSolverInterface *> &solver_;
+};
+
+void SmiScenarioWorkerPoolUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	OsiClpSolverInterface clp;
+
+	// every index is visited once, with the solver of its worker
+	SmiScenarioWorkerPool pool(&clp,4);
+	int nw = pool.getNumWorkers();
+	myAssert(__FILE__,__LINE__,nw >= 1 && nw <= 4);
+	std::vector<int> owner(100,-1);
+	std::vector<OsiSolverInterface *> solver(100,(OsiSolverInterface *)NULL);
+	SmiTestPoolVisit visit(owner,solver);
+	pool.run(100,visit);
+	for (int i=0; i<100; i++)
+	{
+		myAssert(__FILE__,__LINE__,owner[i] >= 0 && owner[i] < nw);
+		myAssert(__FILE__,__LINE__,solver[i]==pool.getSolver(owner[i]));
+	}
+
+	// Benders on Bug gives the same iterates on one and on four threads
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/bug").c_str()));
+	for (int multi=0; multi<2; multi++)
+	{
+		SmiBendersSolver serial(&smi,&clp);
+		serial.setMultiCut(multi==1);
+		serial.setNumThreads(1);
+		myAssert(__FILE__,__LINE__,serial.solve()==0);
+
+		SmiBendersSolver threaded(&smi,&clp);
+		threaded.setMultiCut(multi==1);
+		threaded.setNumThreads(4);
+		myAssert(__FILE__,__LINE__,threaded.solve()==0);
+
+		myAssert(__FILE__,__LINE__,serial.getNumIterations()==threaded.getNumIterations());
+		myAssert(__FILE__,__LINE__,serial.getNumOptimalityCuts()==threaded.getNumOptimalityCuts());
+		myAssert(__FILE__,__LINE__,fabs(serial.getObjValue()-threaded.getObjValue()) < 1.0e-8);
+		myAssert(__FILE__,__LINE__,fabs(serial.getLowerBound()-threaded.getLowerBound()) < 1.0e-8);
+	}
+	printf(" *** Successfully tested scenario worker pool.\n");
+}
+
+void SmiNestedBendersSolverUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	OsiClpSolverInterface clp;
+	SmiNestedBendersSolver::Protocol protocol[] = {
+		SmiNestedBendersSolver::FastForwardFastBack,
+		SmiNestedBendersSolver::FastForward,
+		SmiNestedBendersSolver::FastBack };
+
+	// three-stage model app0110: LP value of the det. eq. with every protocol;
+	// its stage 3 rows reach back to the stage 1 columns
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+	for (int p=0; p<3; p++)
+	{
+		SmiNestedBendersSolver nested(&smi,&clp);
+		nested.setProtocol(protocol[p]);
+		myAssert(__FILE__,__LINE__,nested.getNumStages()==3);
+		myAssert(__FILE__,__LINE__,nested.solve()==0);
+		myAssert(__FILE__,__LINE__,fabs(nested.getObjValue()-44.66666) < 0.0001);
+		myAssert(__FILE__,__LINE__,nested.getLowerBound() <= nested.getUpperBound());
+		myAssert(__FILE__,__LINE__,nested.getNumOptimalityCuts() > 0);
+		myAssert(__FILE__,__LINE__,nested.getColSolution()!=NULL);
+	}
+
+	// two-stage model Bug: same value as the L-shaped method
+	SmiScnModel smiBug;
+	myAssert(__FILE__,__LINE__,-1!=smiBug.readSmps((dataDir+"/bug").c_str()));
+	SmiBendersSolver benders(&smiBug,&clp);
+	myAssert(__FILE__,__LINE__,benders.solve()==0);
+	for (int p=0; p<3; p++)
+	{
+		SmiNestedBendersSolver nested(&smiBug,&clp);
+		nested.setProtocol(protocol[p]);
+		myAssert(__FILE__,__LINE__,nested.solve()==0);
+		myAssert(__FILE__,__LINE__,fabs(nested.getObjValue()-benders.getObjValue()) < 0.0001);
+	}
+
+	/* Three stages where the stage 2 node is only infeasible through the
+	 * feasibility cut of its children; the first solution x=0 needs two
+	 * feasibility cuts before it moves.
+	 *
+	 *    minimize x
+	 *      R0:  x         >= 0        x in [0,10]
+	 *      R1:      y     <= 1        y in [0,1]
+	 *      R2: -x - y + z <= 0        z >= 0
+	 *      R3:          z >= 3 or 2
+	 */
+	double INF=clp.getInfinity();
+	int iColStarts[] = {0,2,4,6};
+	int iRowIndice[] = {0,2, 1,2, 2,3};
+	double dEls[] = {1,-1, 1,-1, 1,1};
+	double dClo[] = {0,0,0};
+	double dCup[] = {10,1,INF};
+	double dObj[] = {1,0,0};
+	double dRlo[] = {0,-INF,-INF,3};
+	double dRup[] = {INF,1,0,INF};
+	int iColStages[] = {0,1,2};
+	int iRowStages[] = {0,1,2,2};
+	OsiClpSolverInterface osi;
+	osi.loadProblem(3,4,iColStarts,iRowIndice,dEls,dClo,dCup,dObj,dRlo,dRup);
+	SmiCoreData *core = new SmiCoreData(&osi,3,iColStages,iRowStages);
+
+	int indices[] = {3};
+	double drlo0[] = {3.0};
+	double drlo1[] = {2.0};
+	CoinPackedVector rlo0(1,indices,drlo0);
+	CoinPackedVector rlo1(1,indices,drlo1);
+	SmiScnModel *smiF = new SmiScnModel();
+	smiF->generateScenario(core,NULL,NULL,NULL,NULL,&rlo0,NULL,1,0,0.5);
+	smiF->generateScenario(core,NULL,NULL,NULL,NULL,&rlo1,NULL,2,0,0.5);
+	for (int p=0; p<3; p++)
+	{
+		SmiNestedBendersSolver nested(smiF,&clp);
+		nested.setProtocol(protocol[p]);
+		myAssert(__FILE__,__LINE__,nested.solve()==0);
+		myAssert(__FILE__,__LINE__,nested.getNumFeasibilityCuts() >= 2);
+		myAssert(__FILE__,__LINE__,fabs(nested.getObjValue()-2.0) < 0.0001);
+		myAssert(__FILE__,__LINE__,fabs(nested.getColSolution()[0]-2.0) < 0.0001);
+	}
+	delete smiF;
+	delete core;
+	printf(" *** Successfully tested nested L-shaped decomposition.\n");
+}
+
+void SmiProgressiveHedgingSolverUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	OsiClpSolverInterface clp;
+
+	// three-stage LP app0110R, det. eq. value 44.66666: the bounds enclose it
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110R").c_str()));
+	SmiProgressiveHedgingSolver ph(&smi,&clp);
+	ph.setAdaptiveRho(true);
+	ph.setMaxIterations(50);
+	ph.setBoundFrequency(10);
+	ph.setNumThreads(1);
+	myAssert(__FILE__,__LINE__,ph.solve()>=0);
+	myAssert(__FILE__,__LINE__,ph.getLowerBound() <= 44.66666+0.0001);
+	myAssert(__FILE__,__LINE__,ph.getUpperBound() >= 44.66666-0.0001);
+	myAssert(__FILE__,__LINE__,ph.getColSolution()!=NULL);
+	myAssert(__FILE__,__LINE__,ph.getScenarioSolution(0)!=NULL);
+
+	// one report line per iteration; iteration 0 has the Wait-and-See bound
+	const std::vector<SmiPHReport> &report = ph.getReport();
+	myAssert(__FILE__,__LINE__,(int)report.size()==ph.getNumIterations()+1);
+	myAssert(__FILE__,__LINE__,report[0].iteration==0);
+	myAssert(__FILE__,__LINE__,report[0].lowerBound <= 44.66666+0.0001);
+	myAssert(__FILE__,__LINE__,report[0].rho==1.0);
+	for (unsigned int i=0; i<report.size(); i++)
+		myAssert(__FILE__,__LINE__,report[i].lowerBound <= report[i].upperBound);
+
+	// the same iterates on four threads
+	SmiProgressiveHedgingSolver ph4(&smi,&clp);
+	ph4.setAdaptiveRho(true);
+	ph4.setMaxIterations(50);
+	ph4.setBoundFrequency(10);
+	ph4.setNumThreads(4);
+	myAssert(__FILE__,__LINE__,ph4.solve()>=0);
+	const std::vector<SmiPHReport> &report4 = ph4.getReport();
+	myAssert(__FILE__,__LINE__,report4.size()==report.size());
+	for (unsigned int i=0; i<report.size(); i++)
+	{
+		myAssert(__FILE__,__LINE__,fabs(report4[i].convergence-report[i].convergence) < 1.0e-9);
+		myAssert(__FILE__,__LINE__,report4[i].rho==report[i].rho);
+	}
+
+	// two-stage LP Bug: fixed rho, bounds around the det. eq.
+	SmiScnModel smiBug;
+	myAssert(__FILE__,__LINE__,-1!=smiBug.readSmps((dataDir+"/bug").c_str()));
+	OsiClpSolverInterface *clpBug = new OsiClpSolverInterface();
+	smiBug.setOsiSolverHandle(*clpBug);
+	OsiSolverInterface *osiStoch = smiBug.loadOsiSolverData();
+	osiStoch->initialSolve();
+	double detEq = osiStoch->getObjValue();
+	SmiProgressiveHedgingSolver phBug(&smiBug,&clp);
+	phBug.setRho(0.5);
+	myAssert(__FILE__,__LINE__,phBug.solve()>=0);
+	myAssert(__FILE__,__LINE__,phBug.getLowerBound() <= detEq+0.0001);
+	myAssert(__FILE__,__LINE__,phBug.getUpperBound() >= detEq-0.0001);
+	myAssert(__FILE__,__LINE__,phBug.getConvergence() >= 0.0);
+
+	/* Two stages with a binary first-stage column; the scenarios want
+	 * different x, and with rho=3 the exact binary penalty moves both to
+	 * x=1 in one iteration.
+	 *
+	 *    minimize 3x + y
+	 *      R0:  x      <= 1       x binary
+	 *      R1: 10x + y >= 2 or 8  y >= 0
+	 */
+	double INF=clp.getInfinity();
+	int iColStarts[] = {0,2,3};
+	int iRowIndice[] = {0,1, 1};
+	double dEls[] = {1,10, 1};
+	double dClo[] = {0,0};
+	double dCup[] = {1,INF};
+	double dObj[] = {3,1};
+	double dRlo[] = {-INF,2};
+	double dRup[] = {1,INF};
+	int iColStages[] = {0,1};
+	int iRowStages[] = {0,1};
+	int iIntCols[] = {0};
+	OsiClpSolverInterface osi;
+	osi.loadProblem(2,2,iColStarts,iRowIndice,dEls,dClo,dCup,dObj,dRlo,dRup);
+	SmiCoreData *core = new SmiCoreData(&osi,2,iColStages,iRowStages,iIntCols,1);
+	myAssert(__FILE__,__LINE__,core->getIntCols(0).size()==1);
+
+	int indices[] = {1};
+	double drlo0[] = {2.0};
+	double drlo1[] = {8.0};
+	CoinPackedVector rlo0(1,indices,drlo0);
+	CoinPackedVector rlo1(1,indices,drlo1);
+	SmiScnModel *smiMip = new SmiScnModel();
+	smiMip->generateScenario(core,NULL,NULL,NULL,NULL,&rlo0,NULL,1,0,0.5);
+	smiMip->generateScenario(core,NULL,NULL,NULL,NULL,&rlo1,NULL,1,0,0.5);
+	{
+		SmiProgressiveHedgingSolver phMip(smiMip,&clp);
+		phMip.setRho(3.0);
+		myAssert(__FILE__,__LINE__,phMip.solve()==0);
+		myAssert(__FILE__,__LINE__,phMip.getNumIterations()==1);
+		// Wait-and-See 2.5 at iteration 0
+		myAssert(__FILE__,__LINE__,fabs(phMip.getReport()[0].lowerBound-2.5) < 0.0001);
+		myAssert(__FILE__,__LINE__,fabs(phMip.getLowerBound()-3.0) < 0.0001);
+		myAssert(__FILE__,__LINE__,fabs(phMip.getUpperBound()-3.0) < 0.0001);
+		myAssert(__FILE__,__LINE__,fabs(phMip.getColSolution()[0]-1.0) < 0.0001);
+		for (int is=0; is<2; is++)
+		{
+			double x = phMip.getScenarioSolution(is)[0];
+			myAssert(__FILE__,__LINE__,fabs(x-floor(x+0.5)) < 0.0001);
+		}
+	}
+	delete smiMip;
+	delete core;
+	printf(" *** Successfully tested Progressive Hedging.\n");
+
+	delete clpBug;
+}
+
+void SmiTreeArenaUnitTest()
+{
+	// node i of the arena holds the i-th element of wholeTree()
+	int d[7] = {0,1,2,3,4,5,6};
+	SmiScenarioTree<int *> s;
+	vector<int *> path(3);
+	path[0] = &d[0]; path[1] = &d[1]; path[2] = &d[2];
+	int is0 = s.addPathtoLeaf(0,0,path);
+	vector<int *> path1(1,&d[3]);
+	int is1 = s.addPathtoLeaf(is0,1,path1);
+	vector<int *> path2(2);
+	path2[0] = &d[4]; path2[1] = &d[5];
+	int is2 = s.addPathtoLeaf(is1,0,path2);
+	vector<int *> path3(1,&d[6]);
+	s.addPathtoLeaf(is2,1,path3);
+
+	vector<int *> &whole = s.wholeTree();
+	myAssert(__FILE__,__LINE__,whole.size()==7);
+	for (int i=0; i<7; i++)
+		myAssert(__FILE__,__LINE__,whole[i]==&d[i]);
+
+	for (int is=0; is<s.getNumScenarios(); is++)
+	{
+		SmiTreeNode<int *> *n = s.getLeaf(is);
+		myAssert(__FILE__,__LINE__,n->depth()==2);
+		while (n)
+		{
+			myAssert(__FILE__,__LINE__,whole[n->index()]==n->getDataPtr());
+			myAssert(__FILE__,__LINE__,s.find(is,n->depth())==n);
+			if (n->hasParent())
+				myAssert(__FILE__,__LINE__,n->getParent()->index() < n->index());
+			n = n->getParent();
+		}
+	}
+
+	// children newest first, each with one parent
+	SmiTreeNode<int *> *root = s.getRoot();
+	myAssert(__FILE__,__LINE__,root->index()==0);
+	myAssert(__FILE__,__LINE__,root->numChildren()==2);
+	myAssert(__FILE__,__LINE__,root->getChild()->getDataPtr()==&d[4]);
+	myAssert(__FILE__,__LINE__,root->getChild()->getSibling()->getDataPtr()==&d[1]);
+	myAssert(__FILE__,__LINE__,root->getChild()->getSibling()->getParent()==root);
+	myAssert(__FILE__,__LINE__,s.getLeaf(3)->scenario()==3);
+
+	// handles stay valid across arena blocks
+	SmiTreeNode<int *> *top = new SmiTreeNode<int *>(&d[0]);
+	vector<SmiTreeNode<int *> *> kids;
+	for (int i=0; i<5000; i++)
+		kids.push_back(top->addChild(&d[i%7],i));
+	myAssert(__FILE__,__LINE__,top->numChildren()==5000);
+	SmiTreeNode<int *> *c = top->getChild();
+	for (int i=4999; i>=0; i--, c=c->getSibling())
+	{
+		myAssert(__FILE__,__LINE__,c==kids[i]);
+		myAssert(__FILE__,__LINE__,c->scenario()==i);
+		myAssert(__FILE__,__LINE__,c->getParent()==top);
+	}
+	myAssert(__FILE__,__LINE__,c==NULL);
+	delete top;
+
+	printf(" *** Successfully tested tree arena.\n");
+}
+
+void SmiTreeTeardownUnitTest()
+{
+	// shapes that overflowed the stack with recursive node destructors
+	int d = 0;
+	const int n = 1000000;
+
+	// two-stage tree with a million scenarios
+	{
+		SmiScenarioTree<int *> s;
+		vector<int *> path(2,&d);
+		int is = s.addPathtoLeaf(0,0,path);
+		vector<int *> leaf(1,&d);
+		for (int i=1; i<n; i++)
+			is = s.addPathtoLeaf(is,0,leaf);
+		myAssert(__FILE__,__LINE__,s.getNumScenarios()==n);
+		myAssert(__FILE__,__LINE__,s.getRoot()->numChildren()==n);
+	}
+
+	// root with a million children, and a path a million nodes deep
+	SmiTreeNode<int *> *wide = new SmiTreeNode<int *>(&d);
+	SmiTreeNode<int *> *deep = new SmiTreeNode<int *>(&d);
+	SmiTreeNode<int *> *tail = deep;
+	for (int i=0; i<n; i++)
+	{
+		wide->addChild(&d,i);
+		tail = tail->addChild(&d,0);
+	}
+	myAssert(__FILE__,__LINE__,tail->depth()==n);
+	delete wide;
+	delete deep;
+
+	printf(" *** Successfully tested tree teardown.\n");
+}
+
+void SmiScenarioTreeFindUnitTest()
+{
+	// scenarios of different lengths, branching at every stage
+	int d = 0;
+	SmiScenarioTree<int *> s;
+	vector<int *> path(6,&d);
+	s.addPathtoLeaf(0,0,path);
+	for (int is=1; is<200; is++)
+	{
+		int stage = (is*7)%5;
+		int len = 1 + (is*3)%3;
+		int brscen = (is*13+5)%is;
+		if (stage >= s.getLeaf(brscen)->depth())
+			stage = s.getLeaf(brscen)->depth()-1;
+		vector<int *> branch(len,&d);
+		myAssert(__FILE__,__LINE__,s.addPathtoLeaf(brscen,stage,branch)==is);
+		myAssert(__FILE__,__LINE__,s.getLeaf(is)->depth()==stage+len);
+	}
+
+	// the ancestor table agrees with the parent links
+	for (int is=0; is<s.getNumScenarios(); is++)
+	{
+		SmiTreeNode<int *> *n = s.getLeaf(is);
+		for (int t=n->depth(); t>=0; t--, n=n->getParent())
+			myAssert(__FILE__,__LINE__,s.find(is,t)==n);
+		myAssert(__FILE__,__LINE__,n==NULL);
+	}
+
+	printf(" *** Successfully tested scenario tree find.\n");
+}
+
+void SmiTreeLabelUnitTest()
+{
+	// the same labels under many parents share one table
+	int d = 0;
+	SmiTreeNode<int *> *root = new SmiTreeNode<int *>(&d);
+	vector<SmiTreeNode<int *> *> parents;
+	for (int i=0; i<100; i++)
+	{
+		parents.push_back(root->addChild(&d,i));
+		root->setLastChildLabel(1000*i);
+	}
+	for (int i=0; i<100; i++)
+		for (int j=0; j<50; j++)
+		{
+			parents[i]->addChild(&d,j);
+			parents[i]->setLastChildLabel(j-25);
+		}
+
+	for (int i=0; i<100; i++)
+	{
+		myAssert(__FILE__,__LINE__,root->getChildByLabel(1000*i)==parents[i]);
+		SmiTreeNode<int *> *c = parents[i]->getChild();
+		for (int j=49; j>=0; j--, c=c->getSibling())
+		{
+			myAssert(__FILE__,__LINE__,parents[i]->getChildByLabel(j-25)==c);
+			myAssert(__FILE__,__LINE__,c->getChildByLabel(j-25)==NULL);
+		}
+		myAssert(__FILE__,__LINE__,parents[i]->getChildByLabel(25)==NULL);
+	}
+	myAssert(__FILE__,__LINE__,root->getChildByLabel(1)==NULL);
+
+	// a label is not moved once set
+	SmiTreeNode<int *> *first = parents[0]->getChildByLabel(0);
+	parents[0]->addChild(&d,50);
+	parents[0]->setLastChildLabel(0);
+	myAssert(__FILE__,__LINE__,parents[0]->getChildByLabel(0)==first);
+
+	delete root;
+
+	printf(" *** Successfully tested tree labels.\n");
+}
+
+void SmiScnModelReductionUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	for (int m=0; m<2; m++)
+	{
+		SmiScenarioReduction::Method method = (m==0) ?
+			SmiScenarioReduction::ForwardSelection : SmiScenarioReduction::BackwardReduction;
+
+		// app0110: 9 scenarios, 3 stages
+		SmiScnModel smi;
+		myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+		myAssert(__FILE__,__LINE__,smi.getNumScenarios()==9);
+		double total = smi.getRootNode()->getProb();
+		SmiCoreData *core = smi.getRootNode()->getNode()->getCore();
+
+		// keeping every scenario changes nothing
+		myAssert(__FILE__,__LINE__,smi.reduceScenarios(9,method)==0.0);
+		myAssert(__FILE__,__LINE__,smi.getNumScenarios()==9);
+
+		double d = smi.reduceScenarios(4,method);
+		myAssert(__FILE__,__LINE__,d > 0.0);
+		myAssert(__FILE__,__LINE__,smi.getNumScenarios()==4);
+		myAssert(__FILE__,__LINE__,fabs(smi.getRootNode()->getProb()-total) < 1.0e-9);
+		double sum = 0.0;
+		for (int is=0; is<4; is++)
+		{
+			myAssert(__FILE__,__LINE__,smi.getSmiTree()->getLeaf(is)->depth()==2);
+			myAssert(__FILE__,__LINE__,smi.getLeafNode(is)->getScenarioIndex()==is);
+			sum += smi.getLeafNode(is)->getProb();
+		}
+		myAssert(__FILE__,__LINE__,fabs(sum-total) < 1.0e-9);
+
+		// the det. eq. of the reduced tree
+		int ncol = 0;
+		vector<SmiScnNode *> &nodes = smi.getSmiTree()->wholeTree();
+		for (unsigned int k=0; k<nodes.size(); k++)
+			ncol += core->getNumCols(nodes[k]->getStage());
+		OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+		smi.setOsiSolverHandle(*clp);
+		OsiSolverInterface *osiStoch = smi.loadOsiSolverData();
+		myAssert(__FILE__,__LINE__,osiStoch->getNumCols()==ncol);
+		osiStoch->initialSolve();
+		myAssert(__FILE__,__LINE__,osiStoch->isProvenOptimal());
+
+		myAssert(__FILE__,__LINE__,smi.reduceScenarios(1,method) > 0.0);
+		myAssert(__FILE__,__LINE__,smi.getNumScenarios()==1);
+		myAssert(__FILE__,__LINE__,fabs(smi.getLeafNode(0)->getProb()-total) < 1.0e-9);
+		osiStoch = smi.loadOsiSolverData();
+		myAssert(__FILE__,__LINE__,osiStoch->getNumCols()==core->getNumCols());
+		osiStoch->initialSolve();
+		myAssert(__FILE__,__LINE__,osiStoch->isProvenOptimal());
+		delete clp;
+
+		// tolerance: 0 only merges identical scenarios, a large one keeps a single scenario
+		SmiScnModel smiTol;
+		myAssert(__FILE__,__LINE__,-1!=smiTol.readSmps((dataDir+"/app0110").c_str()));
+		myAssert(__FILE__,__LINE__,smiTol.reduceScenariosToTolerance(0.0,method)==0.0);
+		myAssert(__FILE__,__LINE__,smiTol.getNumScenarios()>1);
+		smiTol.reduceScenariosToTolerance(1.0e10,method);
+		myAssert(__FILE__,__LINE__,smiTol.getNumScenarios()==1);
+	}
+
+	printf(" *** Successfully tested scenario reduction.\n");
+}
+
+void SmiScnModelShareNodeDataUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+
+	// app0110: the stage 3 data of the 9 scenarios takes 3 values
+	SmiScnModel smi, smiShared;
+	smiShared.setShareNodeData(true);
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,-1!=smiShared.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,smiShared.getNumScenarios()==9);
+
+	std::set<SmiNodeData *> data, dataShared;
+	for (int is=0; is<9; is++)
+	{
+		data.insert(smi.getLeafNode(is)->getNode());
+		dataShared.insert(smiShared.getLeafNode(is)->getNode());
+	}
+	myAssert(__FILE__,__LINE__,data.size()==9);
+	myAssert(__FILE__,__LINE__,dataShared.size()==3);
+
+	// shared data is read only
+	SmiNodeData *leaf = smi.getLeafNode(0)->getNode();
+	SmiNodeData *leafShared = smiShared.getLeafNode(0)->getNode();
+	myAssert(__FILE__,__LINE__,!leaf->isInterned());
+	myAssert(__FILE__,__LINE__,leafShared->isInterned());
+	myAssert(__FILE__,__LINE__,leaf->getMutableRowLowerElements()!=NULL);
+	myAssert(__FILE__,__LINE__,leafShared->getMutableRowLowerElements()==NULL);
+	myAssert(__FILE__,__LINE__,leafShared->getInternHash()==leafShared->contentHash());
+
+	// same det. eq. with and without sharing
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	OsiClpSolverInterface *clpShared = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	smiShared.setOsiSolverHandle(*clpShared);
+	OsiSolverInterface *osi = smi.loadOsiSolverData();
+	OsiSolverInterface *osiShared = smiShared.loadOsiSolverData();
+	myAssert(__FILE__,__LINE__,osi->getNumRows()==osiShared->getNumRows());
+	myAssert(__FILE__,__LINE__,osi->getNumCols()==osiShared->getNumCols());
+	myAssert(__FILE__,__LINE__,osi->getNumElements()==osiShared->getNumElements());
+	int i;
+	for (i=0; i<osi->getNumRows(); i++)
+	{
+		myAssert(__FILE__,__LINE__,osi->getRowLower()[i]==osiShared->getRowLower()[i]);
+		myAssert(__FILE__,__LINE__,osi->getRowUpper()[i]==osiShared->getRowUpper()[i]);
+	}
+	osiShared->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osiShared->getObjValue()-44.66666) < 0.0001);
+
+	// shared data outlives the scenarios removed by a reduction
+	smiShared.reduceScenarios(4);
+	myAssert(__FILE__,__LINE__,smiShared.getNumScenarios()==4);
+	osiShared = smiShared.loadOsiSolverData();
+	osiShared->initialSolve();
+	myAssert(__FILE__,__LINE__,osiShared->isProvenOptimal());
+
+	delete clp;
+	delete clpShared;
+	printf(" *** Successfully tested sharing of node data.\n");
+}
+
+void SmiNodeDataArenaUnitTest()
+{
+	// allocations are aligned for doubles; the last one can be given back
+	SmiNodeDataArena *arena = new SmiNodeDataArena(1024);
+	arena->addRef();
+	for (int i=0; i<1000; i++)
+	{
+		size_t n = (i*37)%200+1;
+		char *p = static_cast<char *>(arena->allocate(n));
+		myAssert(__FILE__,__LINE__,(reinterpret_cast<size_t>(p) & (sizeof(double)-1))==0);
+		memset(p,1,n);
+	}
+	size_t used = arena->getNumBytes();
+	void *p1 = arena->allocate(24);
+	arena->release(p1,24);
+	myAssert(__FILE__,__LINE__,arena->getNumBytes()==used);
+	myAssert(__FILE__,__LINE__,arena->allocate(24)==p1);
+	void *big = arena->allocate(5000);
+	memset(big,1,5000);
+	arena->release(big,5000);
+	if (arena->deleteRef()==0)
+		delete arena;
+
+	// node data of a model lives in its arena
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	SmiScnModel smi, smiShared;
+	smiShared.setShareNodeData(true);
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,-1!=smiShared.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,smi.getNodeDataArena()->getNumBlocks()==1);
+	myAssert(__FILE__,__LINE__,smi.getNodeDataArena()->getNumBytes() > 0);
+	// dropped duplicates are given back
+	myAssert(__FILE__,__LINE__,smiShared.getNodeDataArena()->getNumBytes() < smi.getNodeDataArena()->getNumBytes());
 
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiStoch = smi.loadOsiSolverData();
+	osiStoch->initialSolve();
+	myAssert(__FILE__,__LINE__,fabs(osiStoch->getObjValue()-44.66666) < 0.0001);
+	delete clp;
+
+	printf(" *** Successfully tested node data arena.\n");
+}
+
+void SmiNodeDataTripletUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+	SmiCoreData *core = smi.getRootNode()->getNode()->getCore();
+	int nrow = core->getNumRows();
+	int ncol = core->getNumCols();
+
+	// one entry in the first row of stages 1 and 2, in core (external) indices
+	int rows[3], cols[3];
+	double els[3] = { 5.0, 2.0, 3.0 };
+	rows[0] = rows[1] = core->getRowExternalIndex(core->getRowStart(1));
+	cols[0] = cols[1] = core->getColExternalIndex(core->getColStart(1));
+	rows[2] = core->getRowExternalIndex(core->getRowStart(2));
+	cols[2] = core->getColExternalIndex(core->getColStart(2));
+
+	// the same data as a matrix of the size of the core
+	CoinPackedMatrix matrix(false,0.25,0.25);
+	matrix.setDimensions(nrow,ncol);
+	for (int k=1; k<3; k++)
+		matrix.modifyCoefficient(rows[k],cols[k],els[k],true);
+
+	CoinPackedVector drlo;
+	drlo.insert(rows[2],-1.0);
+	int isMat = smi.generateScenario(core,&matrix,NULL,NULL,NULL,&drlo,NULL,1,0,0.1);
+	// the first triplet is repeated; the last one counts
+	int isTrip = smi.generateScenario(core,3,rows,cols,els,NULL,NULL,NULL,&drlo,NULL,1,0,0.1);
+	myAssert(__FILE__,__LINE__,smi.getNumScenarios()==11);
+
+	SmiScnNode *leafMat = smi.getLeafNode(isMat);
+	SmiScnNode *leafTrip = smi.getLeafNode(isTrip);
+	for (int t=2; t>0; t--)
+	{
+		SmiNodeData *nodeMat = leafMat->getNode();
+		SmiNodeData *nodeTrip = leafTrip->getNode();
+		myAssert(__FILE__,__LINE__,nodeTrip->getStage()==t);
+		myAssert(__FILE__,__LINE__,nodeTrip->getNumMatrixElements()==1);
+		myAssert(__FILE__,__LINE__,nodeTrip->sameContent(nodeMat));
+		myAssert(__FILE__,__LINE__,nodeTrip->contentHash()==nodeMat->contentHash());
+		int i = core->getRowStart(t);
+		myAssert(__FILE__,__LINE__,nodeTrip->getRowLength(i)==1);
+		myAssert(__FILE__,__LINE__,nodeTrip->getRowIndices(i)[0]==core->getColStart(t));
+		myAssert(__FILE__,__LINE__,nodeTrip->getRowElements(i)[0]==els[t]);
+		leafMat = leafMat->getParent();
+		leafTrip = leafTrip->getParent();
+	}
+
+	printf(" *** Successfully tested node data from triplets.\n");
+}
+
+void SmiSmpsIOScenarioMatrixUnitTest()
+{
+	// app0110 core and time files with matrix entries in the SCENARIOS section
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	const char *ext[2] = { ".cor", ".time" };
+	for (int f=0; f<2; f++)
+	{
+		std::ifstream in((dataDir+"/app0110"+ext[f]).c_str());
+		std::ofstream out((std::string("scnMatrix")+ext[f]).c_str());
+		out << in.rdbuf();
+	}
+	{
+		std::ofstream out("scnMatrix.stoch");
+		out << "NAME          APP\n";
+		out << "SCENARIOS     DISCRETE                 REPLACE\n";
+		out << " SC SCEN01    ROOT             0.5     STAGE-2\n";
+		out << "    I00102    D00103           2.\n";
+		out << "    RHS       D00103          -1.\n";
+		out << "    I00102    D00103           3.\n";
+		out << " SC SCEN02    SCEN01           0.5     STAGE-3\n";
+		out << "    I00103    D00104           4.\n";
+		out << "ENDATA\n";
+	}
+
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps("scnMatrix"));
+	myAssert(__FILE__,__LINE__,smi.getNumScenarios()==2);
+	SmiCoreData *core = smi.getRootNode()->getNode()->getCore();
+
+	CoinMpsIO mps;
+	myAssert(__FILE__,__LINE__,mps.readMps("scnMatrix","cor")>=0);
+	const char *row[2] = { "D00103", "D00104" };
+	const char *col[2] = { "I00102", "I00103" };
+	double el[2] = { 3.0, 4.0 };
+	for (int is=0; is<2; is++)
+	{
+		// stage 3 node of the scenario; repeated entries: the last one counts
+		SmiNodeData *node = smi.getLeafNode(is)->getNode();
+		myAssert(__FILE__,__LINE__,node->getStage()==2);
+		myAssert(__FILE__,__LINE__,node->getNumMatrixElements()==1);
+		int i = core->getRowInternalIndex(mps.rowIndex(row[is]));
+		myAssert(__FILE__,__LINE__,node->getRowLength(i)==1);
+		myAssert(__FILE__,__LINE__,node->getRowIndices(i)[0]==core->getColInternalIndex(mps.columnIndex(col[is])));
+		myAssert(__FILE__,__LINE__,node->getRowElements(i)[0]==el[is]);
+	}
+
+	OsiClpSolverInterface *clp = new OsiClpSolverInterface();
+	smi.setOsiSolverHandle(*clp);
+	OsiSolverInterface *osiStoch = smi.loadOsiSolverData();
+	myAssert(__FILE__,__LINE__,osiStoch->getNumCols()==core->getNumCols()+core->getNumCols(2));
+	delete clp;
+
+	printf(" *** Successfully tested matrix entries of SMPS scenarios.\n");
+}
 
+void SmiSmpsCardReaderMappedUnitTest()
+{
+	std::string dataDir=SMI_TEST_DATA_DIR;
+	const char *ext[2] = { ".time", ".stoch" };
+	CoinMpsIO mps;
+	for (int f=0; f<2; f++)
+	{
+		// same cards from the stream reader and from the mapped file
+		std::string file = dataDir+"/app0110"+ext[f];
+		SmiSmpsMappedFile *mapped = SmiSmpsMappedFile::open(file.c_str());
+		myAssert(__FILE__,__LINE__,mapped!=NULL);
+		SmiSmpsCardReader coinReader(CoinFileInput::create(file),&mps);
+		SmiSmpsCardReader mapReader(mapped,&mps);
+		myAssert(__FILE__,__LINE__,!coinReader.isMapped());
+		myAssert(__FILE__,__LINE__,mapReader.isMapped());
+
+		myAssert(__FILE__,__LINE__,coinReader.readToNextSection()==COIN_NAME_SECTION);
+		myAssert(__FILE__,__LINE__,mapReader.readToNextSection()==COIN_NAME_SECTION);
+		myAssert(__FILE__,__LINE__,!strcmp(coinReader.columnName(),mapReader.columnName()));
+		int numCards=0;
+		SmiSectionType sec=SMI_NO_SECTION,prevSec;
+		do
+		{
+			prevSec = sec;
+			sec = coinReader.nextSmpsField();
+			myAssert(__FILE__,__LINE__,mapReader.nextSmpsField()==sec);
+			// section cards leave the fields of the previous card
+			if (sec!=prevSec)
+				continue;
+			myAssert(__FILE__,__LINE__,mapReader.whichSmpsType()==coinReader.whichSmpsType());
+			myAssert(__FILE__,__LINE__,!strcmp(mapReader.columnName(),coinReader.columnName()));
+			myAssert(__FILE__,__LINE__,!strcmp(mapReader.rowName(),coinReader.rowName()));
+			myAssert(__FILE__,__LINE__,!strcmp(mapReader.periodName(),coinReader.periodName()));
+			myAssert(__FILE__,__LINE__,mapReader.value()==coinReader.value());
+			numCards++;
+		} while (sec==SMI_TIME_SECTION || sec==SMI_SCENARIOS_SECTION || sec==SMI_INDEPENDENT_SECTION);
+		myAssert(__FILE__,__LINE__,sec==SMI_ENDATA_SECTION);
+		myAssert(__FILE__,__LINE__,numCards>3);
+	}
+
+	// readSmps maps the time and stoch files by default
+	SmiSmpsIO smpsIO;
+	myAssert(__FILE__,__LINE__,smpsIO.getMemoryMapping());
+	SmiScnModel smi;
+	myAssert(__FILE__,__LINE__,-1!=smi.readSmps((dataDir+"/app0110").c_str()));
+	myAssert(__FILE__,__LINE__,smi.getNumScenarios()==9);
+
+	printf(" *** Successfully tested memory mapped SMPS files.\n");
+}